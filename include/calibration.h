@@ -0,0 +1,40 @@
+/*
+* calibration.h
+* Header file for per-sensor temperature correction
+* Author: Ketturi Electronics
+*/
+
+
+#ifndef calibration_H_
+#define calibration_H_
+
+#include <avr/io.h>
+
+//Correction is piecewise linear between breakpoints, denser around 20-30 degrees.
+//Breakpoints must be increasing multiples of 4 degrees, at most 16 degrees apart.
+#define CALIB_BREAKPOINTS	{0, 16, 20, 24, 28, 32, 40, 56}	//Segment edges in degrees
+#define CALIB_POINTS		8	//Number of breakpoints
+#define CALIB_SEGMENTS		(CALIB_POINTS-1)
+#ifndef CALIB_SENSORS
+#define CALIB_SENSORS		0	//Sensor records in EEPROM as listed in calibration.cpp, 0 leaves correction out
+#endif
+#define CALIB_BUCKET_SHIFT	6	//Segment lookup step, 4 degrees in 1/16 degrees
+
+//Correction of one sensor as given in calibration.cpp
+struct calib_points {
+	uint8_t rom[8];					//ROM ID of sensor
+	int8_t correction[CALIB_POINTS];	//Value added at each breakpoint, 1/16 degrees
+};
+
+//EEPROM record of one sensor, generated from calib_points at compile time
+struct calib_record {
+	uint8_t rom[8];					//ROM ID of sensor, all 0xFF when unused
+	int8_t offset[CALIB_SEGMENTS];	//Correction at segment start, 1/16 degrees
+	int8_t gain[CALIB_SEGMENTS];	//Correction slope, 1/256 per 1/16 degree
+};
+
+//functions
+extern void calib_select(uint8_t *);
+extern int16_t calib_apply(int16_t);
+
+#endif /* calibration_H_ */
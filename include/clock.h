@@ -0,0 +1,30 @@
+/*
+* clock.h
+* Header file for monotonic sampling clock
+* Author: Ketturi Electronics
+*/
+
+
+#ifndef clock_H_
+#define clock_H_
+
+#include <avr/io.h>
+
+//Timer1 in CTC mode with 1/8 prescaler, tick rate is exact for F_CPU divisible by 8*CLOCK_HZ
+#define CLOCK_HZ	100	//Ticks per second
+#define CLOCK_TOP	(F_CPU/8/CLOCK_HZ - 1)
+
+//Define CLOCK_STATS to gather sample jitter statistics, in timer counts of 8/F_CPU (2us)
+#ifdef CLOCK_STATS
+extern uint32_t clock_late_last;	//Lateness of last wake up, 32 bits so lateness over 131ms does not wrap
+extern uint32_t clock_late_max;		//Worst lateness
+extern uint16_t clock_overruns;		//Whole periods missed
+#endif
+
+//functions
+extern void clock_init();
+extern uint16_t clock_ticks();
+extern void clock_wait_next(uint16_t *, uint16_t);
+extern uint8_t clock_due(uint16_t *, uint16_t, uint16_t);
+
+#endif /* clock_H_ */
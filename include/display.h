@@ -9,7 +9,7 @@
 #ifndef display_H_
 #define display_H_
 
-#include <stdio.h>
+#include <stddef.h>
 #include <avr/io.h>
 #include <avr/pgmspace.h>
 #include <util/delay.h>
@@ -33,8 +33,8 @@
 #define LED_CA2 PD4
 #define LED_CA3 PD3
 
-//array of anode outputs
-#define LED_CA_ARRAY {LED_CA1, LED_CA2, LED_CA3}
+//array of anode output masks, saves variable shifts while multiplexing
+#define LED_CA_ARRAY {1 << LED_CA1, 1 << LED_CA2, 1 << LED_CA3}
 
 //Button pin, buttons connected to LED_CA1 and LED_CA2.
 //Must be read with interrupt while multiplexing
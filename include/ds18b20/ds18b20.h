@@ -10,6 +10,7 @@
 #define DS18B20_H
 
 #include <inttypes.h>
+#include <avr/pgmspace.h>
 #include "onewire.h"
 
 #define DS18B20_ERROR_OK       0
@@ -27,6 +28,15 @@
 #define DS18B20_COMMAND_READ_SP 0xBE
 #define DS18B20_COMMAND_COPY_SP 0x48
 #define DS18B20_COMMAND_SEARCH_ROM 0xF0
+#define DS18B20_COMMAND_ALARM_SEARCH 0xEC
+#define DS18B20_COMMAND_RECALL_E2 0xB8
+#define DS18B20_COMMAND_READ_POWER 0xB4
+
+//Transaction descriptor flags
+#define DS18B20_TX_ROM     ( 1 << 0 ) //Select ROM (match or skip) before command
+#define DS18B20_TX_PULL    ( 1 << 1 ) //Fail if first 8 read bytes are all zero
+#define DS18B20_TX_CRC     ( 1 << 2 ) //Last read byte is CRC of others
+#define DS18B20_TX_RELEASE ( 1 << 3 ) //Drive line high after transaction
 
 #define DS18B20_RES09 ( 0 << 5 )
 #define DS18B20_RES10 ( 1 << 5 )
@@ -34,12 +44,88 @@
 #define DS18B20_RES12 ( 3 << 5 )
 
 #define DS18B20_MUL 16
+#define DS18B20_POWERON 0x0550 //Temperature register after power-on, 85 degrees
+
+//Transaction descriptor, kept in PROGMEM and run by ds18b20exec
+//Reset, ROM select, command, wlen bytes written from and rlen bytes read to buffer
+typedef struct
+{
+	uint8_t flags;
+	uint8_t command;
+	uint8_t wlen;
+	uint8_t rlen;
+} ds18b20tx;
 
+//Read slots polled for conversion end, about 1s at 80us per slot
+#define DS18B20_WAIT_SLOTS 12500
+
+extern uint8_t ds18b20exec( const ds18b20tx *tx, uint8_t *rom, uint8_t *buf );
 extern uint8_t ds18b20convert(uint8_t *rom );
 extern uint8_t ds18b20rsp( uint8_t *rom, uint8_t *sp );
 extern uint8_t ds18b20wsp( uint8_t *rom, uint8_t th, uint8_t tl, uint8_t conf );
+extern uint8_t ds18b20wait( void );
 extern uint8_t ds18b20csp( uint8_t *rom );
 extern uint8_t ds18b20read( uint8_t *rom, int16_t *temperature ) ;
 extern uint8_t ds18b20rom( uint8_t *rom );
+extern uint8_t ds18b20rec( uint8_t *rom );
+extern uint8_t ds18b20pwr( uint8_t *rom, uint8_t *parasite );
+extern uint8_t ds18b20crc8( uint8_t *data, uint8_t length );
+extern uint8_t ds18b20spcheck( uint8_t *sp );
+
+//Multi-bus functions, one sensor per lane of OneWireBus
+
+template <class Bus>
+uint8_t ds18b20convertall( )
+{
+	//Send conversion request to DS18B20 on all lanes at once
+	//Returns lane bits of buses without presence pulse
+
+	uint8_t absent = Bus::init( );
+
+	Bus::write( DS18B20_COMMAND_SKIP_ROM );
+	Bus::write( DS18B20_COMMAND_CONVERT );
+
+	return absent;
+}
+
+template <class Bus>
+uint8_t ds18b20readall( int16_t *temperature, uint8_t *ec )
+{
+	//Read temperatures from all lanes with one scratchpad transfer
+	//temperature and ec must hold Bus::Lanes entries
+	//Returns lane bits of failed buses, ec holds error code of each lane
+	//Note: returns actual temperature * 16
+
+	uint8_t sp[Bus::Lanes][9];
+	uint8_t data[Bus::Lanes];
+	uint8_t i, lane, absent, failed = 0;
+
+	absent = Bus::init( );
+
+	Bus::write( DS18B20_COMMAND_SKIP_ROM );
+	Bus::write( DS18B20_COMMAND_READ_SP );
+	for ( i = 0; i < 9; i++ )
+	{
+		Bus::readLanes( data );
+		for ( lane = 0; lane < Bus::Lanes; lane++ )
+		sp[lane][i] = data[lane];
+	}
+
+	for ( lane = 0; lane < Bus::Lanes; lane++ )
+	{
+		if ( absent & ( 1 << lane ) ) ec[lane] = DS18B20_ERROR_COMM;
+		else ec[lane] = ds18b20spcheck( sp[lane] );
+
+		if ( ec[lane] != DS18B20_ERROR_OK )
+		{
+			temperature[lane] = 0;
+			failed |= ( 1 << lane );
+		}
+		else
+		temperature[lane] = (int16_t)( sp[lane][1] << 8 ) + ( sp[lane][0] & 0xFF );
+	}
+
+	return failed;
+}
 
 #endif
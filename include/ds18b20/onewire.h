@@ -12,21 +12,236 @@
 
 #include <inttypes.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
 
 #define ONEWIRE_ERROR_OK 	0
 #define ONEWIRE_ERROR_COMM 	1
-#define ONEWIRE_DIR			DDRD
-#define ONEWIRE_PORT		PORTD
-#define ONEWIRE_PIN			PIND
-#define ONEWIRE_RX			(1 << PD0)
-#define ONEWIRE_TX			(1 >> PD1)
-#define ONEWIRE_PULLDOWN    PORTD &= ~(1<< PD1)
-#define ONEWIRE_PULLUP		PORTD |=(1<< PD1)
+
+//Port descriptors, bus pins are selected at compile time with these
+#define ONEWIRE_PORT_DEF( name, dir, port, pin ) \
+struct name \
+{ \
+	static inline volatile uint8_t &Dir( ) { return dir; } \
+	static inline volatile uint8_t &Port( ) { return port; } \
+	static inline volatile uint8_t &Pin( ) { return pin; } \
+};
+
+ONEWIRE_PORT_DEF( OneWirePortA, DDRA, PORTA, PINA )
+ONEWIRE_PORT_DEF( OneWirePortB, DDRB, PORTB, PINB )
+ONEWIRE_PORT_DEF( OneWirePortD, DDRD, PORTD, PIND )
+
+//Number of pins in mask
+static constexpr uint8_t onewireBits( uint8_t mask )
+{
+	return mask ? ( mask & 1 ) + onewireBits( mask >> 1 ) : 0;
+}
+
+//1-Wire bus driver parameterised by port and pins.
+//RxMask and TxMask may hold several pins, then every bus (lane) is clocked
+//in lockstep: writes are broadcast and reads sample all lanes in the same slot.
+//Lane n uses nth lowest bit of RxMask, lane results are returned as (1 << n) bits.
+template <class IO, uint8_t RxMask, uint8_t TxMask>
+struct OneWireBus
+{
+	enum { Lanes = onewireBits( RxMask ) };
+
+	static_assert( Lanes > 0 && onewireBits( TxMask ) == Lanes, "RxMask and TxMask must have the same number of pins" );
+
+	static inline void pulldown( ) { IO::Port( ) &= ~TxMask; }
+	static inline void pullup( ) { IO::Port( ) |= TxMask; }
+
+	static inline uint8_t gather( uint8_t sample )
+	{
+		//Packs sampled RX pins into lane bits
+
+		uint8_t m, lane = 1, bits = 0;
+
+		if ( Lanes == 1 ) return ( sample & RxMask ) != 0;
+
+		for ( m = 1; m != 0; m <<= 1 )
+		{
+			if ( !( RxMask & m ) ) continue;
+			if ( sample & m ) bits |= lane;
+			lane <<= 1;
+		}
+		return bits;
+	}
+
+	static inline void slotWrite( uint8_t bit )
+	{
+		pulldown( ); //Write 0 to onewire line
+
+		if ( bit != 0 ) _delay_us( 10 ); //Set timeslot start delay
+		else _delay_us( 80 );
+
+		pullup( ); //Set line up
+
+		if ( bit != 0 ) _delay_us( 80 ); //Set timeslot stop delay
+		else _delay_us( 5 );
+	}
+
+	static inline uint8_t slotRead( )
+	{
+		uint8_t sample = 0;
+
+		pulldown( );
+
+		_delay_us( 2 );
+
+		IO::Dir( ) &= ~RxMask; //Set RX port to input
+		pullup( ); //Set onewire pullup
+
+		_delay_us( 8 );
+		sample = IO::Pin( ); //Read input, data is valid only 15us from slot start
+		_delay_us( 66 );
+
+		return gather( sample );
+	}
+
+	static uint8_t init( )
+	{
+		//Init one wire bus (it's basically reset pulse)
+		//Returns lane bits of buses without presence pulse
+
+		uint8_t response = 0;
+		uint8_t sreg = SREG; //Store status register
+
+		cli( ); //Disable interrupts
+
+		IO::Dir( ) |= TxMask; //Set TX as output
+		pulldown( ); //Pull onewire line low
+
+		_delay_us( 600 );
+
+		IO::Dir( ) &= ~RxMask; //Set RX port to input
+		pullup( );
+
+		_delay_us( 70 );
+
+		response = IO::Pin( ); //Read input, presence is certain 60-75us after release
+
+		_delay_us( 230 );
+
+		pullup( );
+
+		_delay_us( 600 );
+
+		SREG = sreg; //Restore status register
+
+		return gather( response );
+	}
+
+	static uint8_t writeBit( uint8_t bit )
+	{
+		uint8_t sreg = SREG;
+
+		cli( );
+		slotWrite( bit );
+		SREG = sreg;
+
+		return bit != 0;
+	}
+
+	static void slotWriteByte( uint8_t data )
+	{
+		//Write byte to all lanes, caller masks interrupts
+
+		uint8_t i = 0;
+
+		for ( i = 1; i != 0; i <<= 1 ) //Write byte in 8 single bit writes
+		slotWrite( data & i );
+	}
+
+	static uint8_t slotReadByte( )
+	{
+		//Read byte from first lane, caller masks interrupts
+
+		uint8_t data = 0;
+		uint8_t i = 0;
+
+		for ( i = 1; i != 0; i <<= 1 ) //Read byte in 8 single bit reads
+		if ( slotRead( ) & 1 ) data |= i;
+
+		return data;
+	}
+
+	static void write( uint8_t data )
+	{
+		//Write byte to all lanes
+
+		uint8_t sreg = SREG; //Store status register
+
+		cli( );
+		slotWriteByte( data );
+		SREG = sreg;
+	}
+
+	static uint8_t readBit( )
+	{
+		uint8_t bits = 0;
+		uint8_t sreg = SREG;
+
+		cli( );
+		bits = slotRead( );
+		SREG = sreg;
+
+		return bits;
+	}
+
+	static uint8_t read( )
+	{
+		//Read byte from first lane
+
+		uint8_t sreg = SREG; //Store status register
+		uint8_t data = 0;
+
+		cli( ); //Disable interrupts
+		data = slotReadByte( );
+		SREG = sreg;
+
+		return data;
+	}
+
+	static void readLanes( uint8_t *data )
+	{
+		//Read one byte from every lane in the same bit slots
+		//data must hold Lanes bytes
+
+		uint8_t sreg = SREG; //Store status register
+		uint8_t i, bits, lane;
+
+		for ( lane = 0; lane < Lanes; lane++ )
+		data[lane] = 0;
+
+		cli( ); //Disable interrupts
+
+		for ( i = 1; i != 0; i <<= 1 )
+		{
+			bits = slotRead( );
+			for ( lane = 0; lane < Lanes; lane++ )
+			if ( bits & ( 1 << lane ) ) data[lane] |= i;
+		}
+
+		SREG = sreg;
+	}
+
+	static void release( )
+	{
+		//Leave line driven high
+
+		pullup( );
+		IO::Dir( ) |= TxMask;
+	}
+};
+
+//Bus of the display unit, RX on PD0 and TX on PD1
+typedef OneWireBus<OneWirePortD, ( 1 << PD0 ), ( 1 << PD1 )> OneWireMain;
 
 extern uint8_t onewireInit(void);
-extern inline uint8_t onewireWriteBit( uint8_t bit );
+extern uint8_t onewireWriteBit( uint8_t bit );
 extern void onewireWrite( uint8_t data );
-extern inline uint8_t onewireReadBit();
+extern uint8_t onewireReadBit();
 extern uint8_t onewireRead();
 
 #endif
@@ -12,5 +12,6 @@
 #include <inttypes.h>
 
 extern uint8_t ds18b20search( uint8_t *romcnt, uint8_t *roms, uint16_t buflen );
+extern uint8_t ds18b20asearch( uint8_t *romcnt, uint8_t *roms, uint16_t buflen );
 
 #endif
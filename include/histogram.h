@@ -0,0 +1,34 @@
+/*
+* histogram.h
+* Header file for long-term temperature histogram
+* Author: Ketturi Electronics
+*/
+
+
+#ifndef histogram_H_
+#define histogram_H_
+
+#include <avr/io.h>
+
+//First band holds everything below HISTOGRAM_BASE and last band everything above.
+//With 12 bands defaults give bands <16, 16-18 ... 34-36 and >=36 degrees.
+#ifndef HISTOGRAM_BINS
+#define HISTOGRAM_BINS		0	//Number of temperature bands, 0 leaves histogram out
+#endif
+#define HISTOGRAM_BASE		16	//Lower edge of second band in degrees
+#define HISTOGRAM_WIDTH		2	//Band width in degrees
+#ifndef HISTOGRAM_BATCH
+#define HISTOGRAM_BATCH		60	//Minutes gathered in RAM before band is written to EEPROM, multiple of 60 up to 240
+#endif
+
+//Define HISTOGRAM_STATS to count EEPROM writes for write rate measurements
+#ifdef HISTOGRAM_STATS
+extern uint16_t histogram_writes;
+#endif
+
+//functions
+extern void histogram_tick(int16_t);
+extern uint16_t histogram_hours(uint8_t);
+extern int8_t histogram_edge(uint8_t);
+
+#endif /* histogram_H_ */
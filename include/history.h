@@ -0,0 +1,28 @@
+/*
+* history.h
+* Header file for compact temperature history
+* Author: Ketturi Electronics
+*/
+
+
+#ifndef history_H_
+#define history_H_
+
+#include <avr/io.h>
+
+//History keeps HISTORY_BYTES*2+1 samples, each the average of 2^HISTORY_DECIMATE readings.
+//With 1s reading interval 16 bytes cover about 2h 20min.
+//Minimum and maximum are rescanned over stored samples when one is added, average is a running sum.
+#ifndef HISTORY_BYTES
+#define HISTORY_BYTES		0	//Sample buffer size, one 4-bit delta per sample, 0 leaves history out
+#endif
+#define HISTORY_DECIMATE	8	//Readings per sample as power of two, 256 readings, at most 8
+#define HISTORY_SHIFT		2	//Delta step as power of two in 1/16 degrees, 0.25 degrees
+
+//functions
+extern void history_add(int16_t);
+extern int16_t history_min();
+extern int16_t history_max();
+extern int16_t history_avg();
+
+#endif /* history_H_ */
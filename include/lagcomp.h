@@ -0,0 +1,24 @@
+/*
+* lagcomp.h
+* Header file for sensor lag compensation
+* Author: Ketturi Electronics
+*/
+
+
+#ifndef lagcomp_H_
+#define lagcomp_H_
+
+#include <avr/io.h>
+
+//First order lag model: true = measured + tau * d(measured)/dt
+#ifndef LAG_TAU
+#define LAG_TAU		0	//Sensor time constant in seconds, 0 disables compensation
+#endif
+#define LAG_SHIFT	8	//Fraction bits of reading average
+#define LAG_WEIGHT	11	//Fraction bits of average weight
+#define LAG_LIMIT	(10*16)	//Largest correction, 1/16 degrees
+
+//functions
+extern int16_t lag_update(int16_t, uint16_t);
+
+#endif /* lagcomp_H_ */
@@ -0,0 +1,24 @@
+/*
+* watchdog.h
+* Header file for watchdog stall record
+* Author: Ketturi Electronics
+*/
+
+
+#ifndef watchdog_H_
+#define watchdog_H_
+
+#include <avr/io.h>
+
+//Main loop stages, recorded to EEPROM if watchdog elapses
+enum { TASK_BOOT, TASK_WAIT, TASK_READ, TASK_CONVERT, TASK_BUTTONS, TASK_READING, TASK_ERROR };
+#define TASK_NONE 0xFF //Erased EEPROM, no watchdog timeout recorded
+
+//State saved by watchdog interrupt before reset
+struct wdt_record {
+	uint8_t task;		//Stage that did not finish, TASK_NONE if empty
+	int16_t sample;		//Last raw reading
+	int16_t max;		//Maximum temperature not yet flushed to EEPROM
+};
+
+#endif /* watchdog_H_ */
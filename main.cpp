@@ -10,7 +10,6 @@
 # define F_CPU 4000000UL
 
 #include <stdlib.h>
-#include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
 #include <avr/io.h>
@@ -21,20 +20,64 @@
 
 #include "include/display.h"
 #include "include/ds18b20/ds18b20.h"
+#include "include/history.h"
+#include "include/histogram.h"
+#include "include/clock.h"
+#include "include/calibration.h"
+#include "include/lagcomp.h"
+#include "include/watchdog.h"
 
 #define READ_INTERVALL_MS 1000 //Time between temperature readings
+#define READ_INTERVALL_TICKS ((uint32_t)READ_INTERVALL_MS*CLOCK_HZ/1000) //Clock ticks between readings, product does not fit 16-bit int
+#define PAGE_HOLD 3 //Readings that selected page stays on display
+#define MINUTE_TICKS (60*CLOCK_HZ) //Interval of maximum temperature EEPROM updates and histogram
+
+//Optional features, left out by default to fit 2 KB flash, see README
+#ifndef FAST_START
+#define FAST_START 0 //Show first reading at once, 9-bit conversion after power-on
+#endif
+#ifndef WATCHDOG_RECORD
+#define WATCHDOG_RECORD 0 //Record stage where main loop stalled and show it after reset
+#endif
+
+//Display pages selected with down button, raw page only with lag compensation
+enum { PAGE_LIVE,
+#if LAG_TAU
+	PAGE_RAW,
+#endif
+	PAGE_MAX,
+#if HISTORY_BYTES
+	PAGE_HISTORY_MIN, PAGE_HISTORY_AVG, PAGE_HISTORY_MAX,
+#endif
+	PAGE_HISTOGRAM, PAGE_COUNT = PAGE_HISTOGRAM + HISTOGRAM_BINS };
 
 char buffer[4] = {16, 17, 4} ; //Buffer for display output digits
 
 int temp_max = 0;			//Maximum temperature variable
+int16_t temp_raw = 0;		//Last reading without lag compensation
 uint16_t EEMEM nv_temp_max;	//Non volatile maximum temperature stored in EEPROM
-uint8_t eeprom_counter = 0;
+#if WATCHDOG_RECORD
+struct wdt_record EEMEM nv_wdt = {TASK_NONE, 0, 0}; //Last watchdog timeout
+volatile uint8_t wdt_task = TASK_BOOT; //Stage main loop is running
+#define WATCHDOG_TASK(task) (wdt_task = (task))
+#else
+#define WATCHDOG_TASK(task)
+#endif
+uint16_t minute_mark = 0;	//Tick of last minute boundary
+uint8_t page = PAGE_LIVE;	//Page currently on display
+uint8_t page_timer = 0;		//Readings left until live temperature is shown again
 
 //prototypes
 void timer0_init(void);
+void watchdog_init(void);
+void watchdog_report(uint8_t);
 void print(int);
 void print_decimal(int16_t);
-void show_max(void);
+void show_page(int16_t);
+void show_band(uint8_t);
+void handle_buttons(void);
+void flush_max(void);
+void handle_reading(int16_t, uint16_t);
 int main(void);
 
 //Sets indicator leds in bitfield
@@ -58,7 +101,7 @@ void timer0_init() //Set and start multiplex timer
 	OCR0A = 52; //F_CPU / 256 / 300Hz
 	TCCR0A = 0x02; //Turnt on CTC mode
 	TIFR |= 0x01; //Clear interupt flag
-	TIMSK = 0x01; //enable timer compare interrupt
+	TIMSK |= 0x01; //enable timer compare interrupt
 	TCCR0B = 0x04; //Set CS10 and CS12 bits for 1024 prescaler
 	
 	//Set button interrupt input
@@ -68,6 +111,66 @@ void timer0_init() //Set and start multiplex timer
 	sei(); //enable global interrupts
 }
 
+//Watchdog in interrupt and reset mode: first timeout after 2s calls
+//WDT_OVERFLOW_vect and clears WDIE, second one 2s later resets MCU.
+//Without WATCHDOG_RECORD plain reset after 4s.
+void watchdog_init()
+{
+	uint8_t sreg = SREG;
+	
+	cli();
+	wdt_reset();
+	MCUSR &= ~(1 << WDRF); //WDE can not be changed while reset flag is set
+	WDTCSR |= (1 << WDCE) | (1 << WDE); //Timed sequence to change prescaler
+#if WATCHDOG_RECORD
+	WDTCSR = (1 << WDIE) | (1 << WDE) | (1 << WDP2) | (1 << WDP1) | (1 << WDP0); //2s
+#else
+	WDTCSR = (1 << WDE) | (1 << WDP3); //4s
+#endif
+	SREG = sreg;
+}
+
+#if WATCHDOG_RECORD
+
+//After watchdog reset shows stage where previous run stalled as Ed.N and last reading,
+//and restores maximum temperature that was not yet flushed.
+//resetflags is MCUSR read before watchdog_init clears it.
+void watchdog_report(uint8_t resetflags)
+{
+	uint8_t task = eeprom_read_byte(&nv_wdt.task);
+	
+	if (task == TASK_NONE) return;
+	eeprom_write_byte(&nv_wdt.task, TASK_NONE); //Report only once
+	if (!(resetflags & (1 << WDRF))) return; //Power-on or external reset, record is stale
+	
+	int16_t max = (int16_t)eeprom_read_word((uint16_t *)&nv_wdt.max);
+	if (max > temp_max){
+		temp_max = max;
+		flush_max();
+	}
+	
+	buffer[0] = 15; //E
+	buffer[1] = 14; //d
+	buffer[2] = task + 1;
+	flag_leds.led_dec = 1;
+	_delay_ms(1500);
+	wdt_reset();
+	
+	print_decimal((int16_t)eeprom_read_word((uint16_t *)&nv_wdt.sample)*10/16);
+	_delay_ms(1500);
+	wdt_reset();
+}
+
+//Watchdog timeout, save state while reset is still 2s away
+ISR (WDT_OVERFLOW_vect){
+	if (wdt_task == TASK_ERROR) return; //Error display waits for reset on purpose
+	
+	eeprom_write_word((uint16_t *)&nv_wdt.sample, temp_raw);
+	eeprom_write_word((uint16_t *)&nv_wdt.max, temp_max);
+	eeprom_write_byte(&nv_wdt.task, wdt_task); //Written last, marks record valid
+}
+#endif
+
 // Timer call for refreshing display
 ISR (TIMER0_COMPA_vect){
 	int dg1 = 0, dg2 = 0;
@@ -103,45 +206,172 @@ ISR (INT0_vect){ //Interrupt for buttons
 	}
 }
 
-//Formats number with leading spaces
+//Decimal place values, digits are counted by subtraction as there is no divide instruction
+static const uint16_t PROGMEM print_units[] = {1000, 100, 10, 1};
+
+//Formats number up to 9999 with leading spaces, 4-digit numbers show their 3 highest digits
 void print(int n) {
-	memset(buffer, 0x00, 4); //Set leading space
-	int len=0;
-	int tmp = n;
-	if (n<0) {
-		tmp = -n;
-	}
-	do {
-		buffer[len++] = tmp%10+1; //add number to buffer
-		tmp/=10;
-	} while(tmp && len<4-1);
-	//Negative sign when negative number
-	if (n<0)	flag_leds.led_neg = 1;
-	else		flag_leds.led_neg = 0;
-	// reverse numbers
-	for(int i=0, j=4-2; i<j; i++, j--) {
-		char c = buffer[i];
-		buffer[i] = buffer[j];
-		buffer[j] = c;
-	}
-	buffer[4-1] = 0;
+	uint8_t i, pos = 0, lead = 1;
+	
+	flag_leds.led_neg = n < 0; //Negative sign when negative number
+	if (n < 0) n = -n;
+	for (i = n < 1000; pos < 3; i++){
+		uint16_t unit = pgm_read_word(&print_units[i]);
+		uint8_t digit = 0;
+		while ((uint16_t)n >= unit){
+			n -= unit;
+			digit++;
+		}
+		if (digit || i == 3) lead = 0;
+		buffer[pos++] = lead ? 0 : digit+1; //Leading space
+	}
 }
 
-//Moves digits and adds 1st decimal
+//Shows tenths with 1st decimal, values from 100.0 up without decimal
 void print_decimal(int16_t input){
-	int16_t output;
+	flag_leds.led_dec = input > -1000 && input < 1000;
+	print(input);
+}
+
+#if HISTOGRAM_BINS
+//Shows hours spent in histogram band, label on first reading is b and lower edge of band
+void show_band(uint8_t bin){
+	uint16_t hours = histogram_hours(bin);
+	int8_t edge = histogram_edge(bin);
 	
-	if (input > -1000 && input < 1000){ //if value [-99.9,99.9] show with 1st decimal
-		output = input; //move decimal point to left
-		flag_leds.led_dec = 1;
+	if (page_timer == PAGE_HOLD){
+		buffer[0] = 12; //b
+		if (bin == 0){
+			buffer[1] = buffer[2] = 20; //Below first edge
+		}
+		else{
+			buffer[1] = edge/10+1;
+			buffer[2] = edge%10+1;
+		}
+		flag_leds.led_neg = flag_leds.led_dec = 0;
 	}
-	else { //if value is [[-999,-100][100,999]] then do not show decimal
+	else if (hours < 1000){
+		print(hours);
 		flag_leds.led_dec = 0;
-		output = input/10;
 	}
-	print(output);
+	else{
+		print_decimal(hours/100); //Thousands of hours with decimal
+	}
 }
+#endif
 
+//Shows live temperature or selected page, history pages show their label on first reading
+void show_page(int16_t value){
+	char label = 0;
+	
+#if HISTOGRAM_BINS
+	if (page >= PAGE_HISTOGRAM){
+		show_band(page - PAGE_HISTOGRAM);
+		return;
+	}
+#endif
+	
+	switch(page){
+		case PAGE_MAX:
+		value = temp_max;
+		break;
+#if LAG_TAU
+		case PAGE_RAW:
+		label = 17; //r
+		value = temp_raw;
+		break;
+#endif
+#if HISTORY_BYTES
+		case PAGE_HISTORY_MIN:
+		label = 18; //L
+		value = history_min();
+		break;
+		case PAGE_HISTORY_AVG:
+		label = 11; //A
+		value = history_avg();
+		break;
+		case PAGE_HISTORY_MAX:
+		label = 19; //H
+		value = history_max();
+		break;
+#endif
+	}
+	
+	if (label && page_timer == PAGE_HOLD){
+		buffer[0] = label;
+		buffer[1] = buffer[2] = 0;
+		flag_leds.led_neg = flag_leds.led_dec = 0;
+	}
+	else{
+		print_decimal(value*10/16);
+	}
+}
+
+//Handles button flags set by INT0, called once per reading
+void handle_buttons(void){
+	uint8_t up = flag_leds.button_up, dn = flag_leds.button_dn;
+	
+	flag_leds.led_3 = 0; //EEPROM indicator of last reset stays on for one reading
+	flag_leds.button_up = flag_leds.button_dn = 0;
+	
+	//Clear stored maximum value if both buttons are pressed
+	if (up && dn){
+		temp_max = 0;
+		flag_leds.led_3 = 1;     //Set EEPROM indicator
+		eeprom_write_word(&nv_temp_max, temp_max); //Write new maximum temp to EEPROM
+		eeprom_busy_wait(); //Wait while EEPROM is being programmed
+	}
+	//Step to next page (stored maximum, history min/avg/max) if down button is pressed
+	else if (dn){
+		if (++page >= PAGE_COUNT) page = PAGE_LIVE;
+		page_timer = PAGE_HOLD;
+	}
+	//Clear high temperature indicator and return to live temperature when up button pressed
+	else if (up){
+		flag_leds.led_1=0;
+		page = PAGE_LIVE;
+	}
+}
+
+//Writes new maximum to EEPROM, called once a minute
+void flush_max(void){
+	if (eeprom_read_word(&nv_temp_max) < temp_max){ //Check if eeprom value needs update
+		flag_leds.led_3 = 1;     //Set EEPROM indicator
+		eeprom_write_word(&nv_temp_max, temp_max); //Write new maximum temp to EEPROM
+		eeprom_busy_wait(); //Wait while EEPROM is being programmed
+		flag_leds.led_3 = 0;
+	}
+}
+
+//Tracks maximum, history and histogram and shows reading or selected page
+//timestamp is clock tick when conversion of the reading was started
+//Maximum, warning and live display use lag compensated estimate, history and histogram raw reading
+void handle_reading(int16_t raw, uint16_t timestamp){
+	int16_t temperature = lag_update(raw, timestamp);
+	
+	temp_raw = raw;
+	if (temperature > temp_max){ //Check if new maximum value is reached
+		temp_max = temperature;
+		//Set temperature notification if new high is reached
+		flag_leds.led_1 = 1;
+	}
+	
+#if HISTORY_BYTES
+	history_add(raw);
+#endif
+	
+	if (clock_due(&minute_mark, MINUTE_TICKS, timestamp)){
+		flush_max();
+#if HISTOGRAM_BINS
+		histogram_tick(raw);
+#endif
+	}
+	
+	//Output temperature with 1 decimal, or selected page
+	show_page(temperature);
+	flag_leds.led_2 = page != PAGE_LIVE; //Page indicator
+	if (page != PAGE_LIVE && --page_timer == 0) page = PAGE_LIVE;
+}
 
 // The main loop. Sets up hardware, then loops forever reading and displaying temperatures.
 int main(void) {
@@ -149,80 +379,87 @@ int main(void) {
 	temp_max = eeprom_read_word(&nv_temp_max); //Read maximum temperature from EEPROM
 	eeprom_busy_wait();	 //Wait until EEPROM is ready
 
-	wdt_enable(WDTO_4S); //Enable watch dog with 4s countdown
+#if WATCHDOG_RECORD
+	uint8_t resetflags = MCUSR; //Reset cause, cleared by watchdog_init
+#endif
+	watchdog_init(); //Enable watch dog, resets 4s after stall
 	
 	display_init(); //Initialize 7-segment display IO pins
 	timer0_init();  //Initialize timer and start multiplexing display
+	clock_init();   //Start sampling clock
+#if WATCHDOG_RECORD
+	watchdog_report(resetflags); //Show where previous run stalled
+#endif
 	
-	int temperature = 0; //Keeps current temperature
+	int16_t temperature = 0; //Keeps current temperature
 	char errorcode = 0; //Holds onewire error code
 	
+#if CALIB_SENSORS
+	uint8_t rom[8]; //ROM ID of sensor
+	if (ds18b20rom(rom) == DS18B20_ERROR_OK) calib_select(rom); //Find correction of connected sensor
+#endif
+	
+#if FAST_START
+	//First reading is shown immediately. After watchdog reset sensor still holds 12-bit setting
+	//and last conversion, after power-on 85 degrees and fast 9-bit conversion is polled instead
+	uint8_t sp[9]; //Scratchpad of sensor
+	bool shown = false;
+	if (ds18b20rsp( NULL, sp) == DS18B20_ERROR_OK){
+		temperature = (int16_t)(sp[1] << 8) + sp[0];
+		if ((sp[4] & DS18B20_RES12) == DS18B20_RES12 && temperature != DS18B20_POWERON){
+			shown = true; //Warm start, configuration is kept
+		}
+		else{
+			shown = ds18b20wsp( NULL, 0, 100, DS18B20_RES09) == DS18B20_ERROR_OK &&
+				ds18b20convert(NULL) == DS18B20_ERROR_OK &&
+				ds18b20wait() == DS18B20_ERROR_OK &&
+				ds18b20read( NULL, &temperature) == DS18B20_ERROR_OK;
+			ds18b20wsp( NULL, 0, 100, DS18B20_RES12); //Set resolution of sensor
+		}
+	}
+	if (shown) print_decimal(calib_apply(temperature)*10/16);
+#else
 	ds18b20wsp( NULL, 0, 100, DS18B20_RES12); //Set resolution of sensor
+#endif
+	
+	uint16_t timestamp = clock_ticks(); //Tick when running conversion was started
+	uint16_t deadline = timestamp;  //Tick when running conversion is read
+	minute_mark = timestamp;
 	
 	//Run loop if DS18B20 is accessible
-	while((errorcode = ds18b20convert(NULL)) == DS18B20_ERROR_OK) {
+	errorcode = ds18b20convert(NULL);
+	while(errorcode == DS18B20_ERROR_OK) {
 		flag_leds.led_4 = 0;
-		_delay_ms(READ_INTERVALL_MS); //delay of sensor reading interval
+		WATCHDOG_TASK(TASK_WAIT);
+		clock_wait_next(&deadline, READ_INTERVALL_TICKS); //Wait until sensor reading interval is elapsed
 		flag_leds.led_4 = 1; //Blink busy indicator
 		
-		//Clear stored maximum value if both buttons are pressed
-		if (flag_leds.button_up && flag_leds.button_dn){
-			temp_max = 0;
-			flag_leds.led_3 = 1;     //Set EEPROM indicator
-			eeprom_write_word(&nv_temp_max, temp_max); //Write new maximum temp to EEPROM
-			eeprom_busy_wait(); //Wait while EEPROM is being programmed
-			_delay_ms(500);
-			flag_leds.led_3 = 0;
-			flag_leds.button_up = flag_leds.button_dn = 0;
-		}
-		
-		//Show stored maximum value if down button is pressed
-		if (flag_leds.button_dn && !flag_leds.button_up){
-			print_decimal(temp_max*10/16);
-			flag_leds.led_2 = 1;
-			_delay_ms(2000);
-			flag_leds.led_2 = 0;
-			flag_leds.button_up = flag_leds.button_dn = 0;
-		}
+		//Get temperature and start next conversion right away to keep sampling on schedule
+		WATCHDOG_TASK(TASK_READ);
+		if((errorcode = ds18b20read( NULL, &temperature)) != DS18B20_ERROR_OK) break;
+		temperature = calib_apply(temperature);
+		uint16_t sample_time = timestamp;
+		timestamp = clock_ticks();
+		WATCHDOG_TASK(TASK_CONVERT);
+		if((errorcode = ds18b20convert(NULL)) != DS18B20_ERROR_OK) break;
 		
-		//Clear high temperature indicator when up button pressed
-		if (flag_leds.button_up && !flag_leds.button_dn){
-			flag_leds.led_1=0;
-			flag_leds.button_up = flag_leds.button_dn = 0;
-		}
-		
-		eeprom_counter++;
-		if (eeprom_counter >= 60 ){ //Check if ~minute is elapsed
-			if (eeprom_read_word(&nv_temp_max) < temp_max){ //Check if eeprom value needs update
-				flag_leds.led_3 = 1;     //Set EEPROM indicator
-				eeprom_write_word(&nv_temp_max, temp_max); //Write new maximum temp to EEPROM
-				eeprom_busy_wait(); //Wait while EEPROM is being programmed
-				flag_leds.led_3 = 0;
-			}
-			eeprom_counter = 0;
-		}
-		
-		//Get temperature and handle it
-		if((errorcode = ds18b20read( NULL, &temperature)) == DS18B20_ERROR_OK){
-			
-			if (temperature > temp_max){ //Check if new maximum value is reached
-				temp_max = temperature;
-				//Set temperature notification if new high is reached
-				flag_leds.led_1 = 1;
-			}
-			
-			print_decimal(temperature*10/16); //Output temperature with 1 decimal
-			wdt_reset(); //Reset watchdog timer before it elapses
-		}
-		else{
-			break;
+		WATCHDOG_TASK(TASK_BUTTONS);
+		handle_buttons();
+		WATCHDOG_TASK(TASK_READING);
+		handle_reading(temperature, sample_time);
+		wdt_reset(); //Reset watchdog timer before it elapses
+#if WATCHDOG_RECORD
+		if (!(WDTCSR & (1 << WDIE))){ //Recovered from stall after timeout interrupt
+			eeprom_write_byte(&nv_wdt.task, TASK_NONE); //Record did not lead to reset
+			WDTCSR |= (1 << WDIE); //Hardware cleared interrupt mode, set it again
 		}
+#endif
 	}
 
 	//Show error if conversion fails and wait watchdog reset
+	WATCHDOG_TASK(TASK_ERROR);
 	buffer[0] = 15;
 	buffer[1] = 17;
 	buffer[2] = errorcode+1;
 	_delay_ms(4000);
 }
-
@@ -0,0 +1,137 @@
+/*
+* calibration.cpp
+* Per-sensor piecewise linear correction in 1/16 degrees fixed point
+* Author : Ketturi Electronics
+*/
+
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include "../include/calibration.h"
+
+#if CALIB_SENSORS
+
+//Calibrated sensors, measured correction (reference - sensor) at each breakpoint.
+//Records are written to EEPROM image, unused ones have ROM ID of 0xFF.
+static constexpr calib_points calib_sensors[CALIB_SENSORS] = {
+	//ROM ID                                             Correction at 0, 16, 20, 24, 28, 32, 40, 56 degrees
+	{{0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, {0, 0, 0, 0, 0, 0, 0, 0}},
+	{{0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, {0, 0, 0, 0, 0, 0, 0, 0}},
+};
+
+static constexpr int16_t calib_edges[CALIB_POINTS] = CALIB_BREAKPOINTS;
+
+#define CALIB_BUCKETS ((calib_edges[CALIB_POINTS-1]*16) >> CALIB_BUCKET_SHIFT)
+
+//Segment lookup table, one entry per 4 degree bucket
+struct calib_table {
+	uint8_t segment[CALIB_BUCKETS];	//Segment of bucket
+	int16_t base[CALIB_SEGMENTS];	//Segment start, 1/16 degrees
+};
+
+struct calib_store {
+	calib_record sensor[CALIB_SENSORS];
+};
+
+static constexpr bool calib_valid()
+{
+	for (uint8_t i = 1; i < CALIB_POINTS; i++){
+		if (calib_edges[i] <= calib_edges[i-1]) return false;
+		if (calib_edges[i] - calib_edges[i-1] > 16) return false;
+		if ((calib_edges[i]*16) & ((1 << CALIB_BUCKET_SHIFT) - 1)) return false;
+	}
+	return calib_edges[0] == 0;
+}
+static_assert(calib_valid(), "CALIB_BREAKPOINTS must start at 0 and increase in steps of 4 to 16 degrees");
+
+static constexpr calib_table calib_make_table()
+{
+	calib_table t{};
+	uint8_t seg = 0;
+	
+	for (uint8_t b = 0; b < CALIB_BUCKETS; b++){
+		while (seg+1 < CALIB_SEGMENTS && calib_edges[seg+1]*16 <= (b << CALIB_BUCKET_SHIFT)) seg++;
+		t.segment[b] = seg;
+	}
+	for (uint8_t s = 0; s < CALIB_SEGMENTS; s++)
+	t.base[s] = calib_edges[s]*16;
+	return t;
+}
+
+static constexpr calib_record calib_make_record(const calib_points &p)
+{
+	calib_record r{};
+	
+	for (uint8_t i = 0; i < 8; i++)
+	r.rom[i] = p.rom[i];
+	for (uint8_t s = 0; s < CALIB_SEGMENTS; s++){
+		int16_t width = (calib_edges[s+1] - calib_edges[s])*16;
+		int32_t slope = (int32_t)(p.correction[s+1] - p.correction[s])*256;
+		int32_t gain = (slope >= 0 ? slope + width/2 : slope - width/2) / width; //Rounded
+		
+		r.offset[s] = p.correction[s];
+		r.gain[s] = gain > 127 ? 127 : gain < -128 ? -128 : gain;
+	}
+	return r;
+}
+
+static constexpr calib_store calib_make_store()
+{
+	calib_store st{};
+	
+	for (uint8_t n = 0; n < CALIB_SENSORS; n++)
+	st.sensor[n] = calib_make_record(calib_sensors[n]);
+	return st;
+}
+
+static const calib_table calib_lookup PROGMEM = calib_make_table();
+calib_store EEMEM nv_calib = calib_make_store();
+
+static uint8_t calib_index = 0xFF; //Record of connected sensor, 0xFF when none
+
+//Selects correction record matching sensor ROM ID
+void calib_select(uint8_t *rom)
+{
+	uint8_t n, i;
+	
+	for (n = 0; n < CALIB_SENSORS; n++){
+		for (i = 0; i < 8; i++)
+		if (eeprom_read_byte(&nv_calib.sensor[n].rom[i]) != rom[i]) break;
+		
+		if (i == 8){
+			calib_index = n;
+			return;
+		}
+	}
+	calib_index = 0xFF;
+}
+
+//Returns corrected temperature, costs table lookup, multiply and shift
+int16_t calib_apply(int16_t t)
+{
+	int16_t bucket, dt;
+	uint8_t seg;
+	
+	if (calib_index == 0xFF) return t;
+	
+	bucket = t >> CALIB_BUCKET_SHIFT;
+	if (bucket < 0) bucket = 0;
+	if (bucket >= CALIB_BUCKETS) bucket = CALIB_BUCKETS-1;
+	
+	seg = pgm_read_byte(&calib_lookup.segment[bucket]);
+	dt = t - (int16_t)pgm_read_word(&calib_lookup.base[seg]);
+	if (dt < 0) dt = 0; //Flat below first breakpoint
+	if (dt > 255) dt = 255; //Keeps product in 16 bits above last breakpoint
+	
+	return t + (int8_t)eeprom_read_byte((uint8_t *)&nv_calib.sensor[calib_index].offset[seg])
+	+ ((dt * (int8_t)eeprom_read_byte((uint8_t *)&nv_calib.sensor[calib_index].gain[seg])) >> 8);
+}
+#else
+void calib_select(uint8_t *)
+{
+}
+
+int16_t calib_apply(int16_t t)
+{
+	return t;
+}
+#endif
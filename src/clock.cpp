@@ -0,0 +1,83 @@
+/*
+* clock.cpp
+* Monotonic tick counter for drift free sampling
+* Author : Ketturi Electronics
+*/
+
+#include <avr/interrupt.h>
+#include "../include/clock.h"
+
+static volatile uint16_t clock_tick = 0;
+
+#ifdef CLOCK_STATS
+uint32_t clock_late_last = 0;
+uint32_t clock_late_max = 0;
+uint16_t clock_overruns = 0;
+#endif
+
+//Set and start tick timer
+void clock_init()
+{
+	uint8_t sreg = SREG;
+	
+	cli();
+	TCCR1A = 0x00;
+	OCR1A = CLOCK_TOP;
+	TCNT1 = 0;
+	TIMSK |= (1 << OCIE1A); //Enable compare interrupt
+	TCCR1B = (1 << WGM12) | (1 << CS11); //CTC mode, 1/8 prescaler
+	SREG = sreg;
+}
+
+ISR (TIMER1_COMPA_vect){
+	clock_tick++;
+}
+
+//Returns ticks since clock_init, wraps around every 655s at 100Hz
+uint16_t clock_ticks()
+{
+	uint16_t t;
+	uint8_t sreg = SREG;
+	
+	cli();
+	t = clock_tick;
+	SREG = sreg;
+	return t;
+}
+
+//Advances deadline by period and waits until it is reached.
+//Deadlines are absolute so time spent between calls does not add up.
+//If more than a period is already lost, missed periods are skipped.
+void clock_wait_next(uint16_t *deadline, uint16_t period)
+{
+	uint16_t next = *deadline + period;
+	
+	if ((int16_t)(clock_ticks() - next) >= (int16_t)period){
+		next = clock_ticks();
+#ifdef CLOCK_STATS
+		clock_overruns++;
+#endif
+	}
+	*deadline = next;
+	
+	while ((int16_t)(clock_ticks() - next) < 0);
+	
+#ifdef CLOCK_STATS
+	uint8_t sreg = SREG;
+	uint32_t late;
+	
+	cli();
+	late = (uint32_t)(uint16_t)(clock_tick - next) * (CLOCK_TOP + 1) + TCNT1;
+	SREG = sreg;
+	clock_late_last = late;
+	if (late > clock_late_max) clock_late_max = late;
+#endif
+}
+
+//Returns 1 and advances mark by period when period has elapsed at time now
+uint8_t clock_due(uint16_t *mark, uint16_t period, uint16_t now)
+{
+	if ((uint16_t)(now - *mark) < period) return 0;
+	*mark += period;
+	return 1;
+}
@@ -30,6 +30,9 @@ static const char PROGMEM segment_table[] ={
 	0b10011110, //E
 	0b10001110, //F
 	0b00001010, //r
+	0b00011100, //L
+	0b01101110, //H
+	0b00000010, //-
 };
 
 //Initialize display control pins
@@ -85,7 +88,7 @@ uint8_t display_selnextdigit()
 	LED_SEG_PORT= 0xFF;
 
 	//Turn previous digit off
-	LED_AUX_PORT |= (1 << display_digits[display_activedigit]);
+	LED_AUX_PORT |= display_digits[display_activedigit];
 	
 	if (display_activedigit < sizeof(display_digits)-1)
 	display_activedigit++;
@@ -93,6 +96,6 @@ uint8_t display_selnextdigit()
 	display_activedigit = 0;
 	
 	//Turn new digit on
-	LED_AUX_PORT &= ~(1 << display_digits[display_activedigit]);
+	LED_AUX_PORT &= ~display_digits[display_activedigit];
 	return display_activedigit;
 }
\ No newline at end of file
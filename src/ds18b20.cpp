@@ -7,11 +7,13 @@
 */
 
 #include <stddef.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
 #include "../include/ds18b20/ds18b20.h"
 #include "../include/ds18b20/onewire.h"
 
-static uint8_t ds18b20crc8( uint8_t *data, uint8_t length )
+uint8_t ds18b20crc8( uint8_t *data, uint8_t length )
 {
 	//Generate 8bit CRC for given data (Maxim/Dallas)
 
@@ -36,65 +38,90 @@ static uint8_t ds18b20crc8( uint8_t *data, uint8_t length )
 	return crc;
 }
 
-static void ds18b20match( uint8_t *rom )
-{
-	//Perform ROM match operation on DS18B20 devices
-	//Or skip ROM matching if ptr is NULL
+//Transactions
+static const ds18b20tx PROGMEM ds18b20txconvert = { DS18B20_TX_ROM, DS18B20_COMMAND_CONVERT, 0, 0 };
+static const ds18b20tx PROGMEM ds18b20txrsp = { DS18B20_TX_ROM | DS18B20_TX_PULL | DS18B20_TX_CRC, DS18B20_COMMAND_READ_SP, 0, 9 };
+static const ds18b20tx PROGMEM ds18b20txwsp = { DS18B20_TX_ROM, DS18B20_COMMAND_WRITE_SP, 3, 0 };
+static const ds18b20tx PROGMEM ds18b20txcsp = { DS18B20_TX_ROM | DS18B20_TX_RELEASE, DS18B20_COMMAND_COPY_SP, 0, 0 };
+static const ds18b20tx PROGMEM ds18b20txrec = { DS18B20_TX_ROM, DS18B20_COMMAND_RECALL_E2, 0, 0 };
+static const ds18b20tx PROGMEM ds18b20txpwr = { DS18B20_TX_ROM, DS18B20_COMMAND_READ_POWER, 0, 1 };
+static const ds18b20tx PROGMEM ds18b20txrom = { DS18B20_TX_PULL | DS18B20_TX_CRC, DS18B20_COMMAND_READ_ROM, 0, 8 };
 
+uint8_t ds18b20exec( const ds18b20tx *tx, uint8_t *rom, uint8_t *buf )
+{
+	//Runs transaction described in PROGMEM
+	//Interrupts are masked once for reset, write and read phase
+	//Skips ROM matching if rom is NULL
+
+	uint8_t flags = pgm_read_byte( &tx->flags );
+	uint8_t wlen = pgm_read_byte( &tx->wlen );
+	uint8_t rlen = pgm_read_byte( &tx->rlen );
+	uint8_t sreg = SREG; //Store status register
 	uint8_t i = 0;
+	uint8_t any = 0;
 
-	//If rom pointer is NULL then read temperature without matching.
-	if ( rom == NULL )
-	{
-		//Skip ROM
-		onewireWrite( DS18B20_COMMAND_SKIP_ROM );
-	}
-	else
+	//Communication check
+	if ( OneWireMain::init( ) != 0 )
+	return DS18B20_ERROR_COMM;
+
+	//ROM select, command and data
+	cli( );
+	if ( flags & DS18B20_TX_ROM )
 	{
-		//Match ROM
-		onewireWrite( DS18B20_COMMAND_MATCH_ROM );
-		for ( i = 0; i < 8; i++ )
-		onewireWrite( rom[i] );
+		if ( rom == NULL )
+		OneWireMain::slotWriteByte( DS18B20_COMMAND_SKIP_ROM );
+		else
+		{
+			OneWireMain::slotWriteByte( DS18B20_COMMAND_MATCH_ROM );
+			for ( i = 0; i < 8; i++ )
+			OneWireMain::slotWriteByte( rom[i] );
+		}
 	}
+	OneWireMain::slotWriteByte( pgm_read_byte( &tx->command ) );
+	for ( i = 0; i < wlen; i++ )
+	OneWireMain::slotWriteByte( buf[i] );
+	SREG = sreg;
+
+	//Read data
+	cli( );
+	for ( i = 0; i < rlen; i++ )
+	any |= buf[i] = OneWireMain::slotReadByte( );
+	SREG = sreg;
+
+	if ( flags & DS18B20_TX_RELEASE )
+	OneWireMain::release( ); //Poor DS18B20 feels better then...
+
+	//Check pull-up, all zero bytes including CRC mean line is held low
+	if ( ( flags & DS18B20_TX_PULL ) && any == 0 )
+	return DS18B20_ERROR_PULL;
+
+	//CRC check
+	if ( ( flags & DS18B20_TX_CRC ) && ds18b20crc8( buf, rlen - 1 ) != buf[rlen - 1] )
+	return DS18B20_ERROR_CRC;
+
+	return DS18B20_ERROR_OK;
 }
 
 uint8_t ds18b20convert( uint8_t *rom )
 {
 	//Send conversion request to DS18B20 on one wire bus
 
-	//Communication check
-	if ( onewireInit( ) == ONEWIRE_ERROR_COMM )
-	return DS18B20_ERROR_COMM;
-
-	//ROM match (or not)
-	ds18b20match( rom );
-
-	//Convert temperature
-	onewireWrite( DS18B20_COMMAND_CONVERT );
-
-	return DS18B20_ERROR_OK;
+	return ds18b20exec( &ds18b20txconvert, rom, NULL );
 }
 
 uint8_t ds18b20rsp( uint8_t *rom, uint8_t *sp )
 {
 	//Read DS18B20 scratchpad
 
-	uint8_t i = 0;
-
-	//Communication check
-	if ( onewireInit( ) == ONEWIRE_ERROR_COMM )
-	return DS18B20_ERROR_COMM;
-
-	//Match (or not) ROM
-	ds18b20match( rom );
+	return ds18b20exec( &ds18b20txrsp, rom, sp );
+}
 
-	//Read scratchpad
-	onewireWrite( DS18B20_COMMAND_READ_SP );
-	for ( i = 0; i < 9; i++ )
-	sp[i] = onewireRead( );
+uint8_t ds18b20spcheck( uint8_t *sp )
+{
+	//Validate received scratchpad
 
 	//Check pull-up
-	if ( *( (uint64_t*) sp ) == 0 )
+	if ( ( sp[0] | sp[1] | sp[2] | sp[3] | sp[4] | sp[5] | sp[6] | sp[7] ) == 0 )
 	return DS18B20_ERROR_PULL;
 
 	//CRC check
@@ -111,42 +138,48 @@ uint8_t ds18b20wsp( uint8_t *rom, uint8_t th, uint8_t tl, uint8_t conf )
 	//tl - thermostat low temperature
 	//conf - configuration byte
 
-	//Communication check
-	if ( onewireInit( ) == ONEWIRE_ERROR_COMM )
-	return DS18B20_ERROR_COMM;
+	uint8_t data[3] = { th, tl, conf };
 
-	//ROM match (or not)
-	ds18b20match( rom );
+	return ds18b20exec( &ds18b20txwsp, rom, data );
+}
 
-	//Write scratchpad
-	onewireWrite( DS18B20_COMMAND_WRITE_SP );
-	onewireWrite( th );
-	onewireWrite( tl );
-	onewireWrite( conf );
+uint8_t ds18b20wait( void )
+{
+	//Polls until started conversion is done
+	//DS18B20 answers read slots with 0 while converting
 
-	return DS18B20_ERROR_OK;
+	uint16_t i = 0;
+
+	for ( i = 0; i < DS18B20_WAIT_SLOTS; i++ )
+	if ( onewireReadBit( ) ) return DS18B20_ERROR_OK;
+
+	return DS18B20_ERROR_COMM;
 }
 
 uint8_t ds18b20csp( uint8_t *rom )
 {
 	//Copies DS18B20 scratchpad contents to its EEPROM
 
-	//Communication check
-	if ( onewireInit( ) == ONEWIRE_ERROR_COMM )
-	return DS18B20_ERROR_COMM;
+	return ds18b20exec( &ds18b20txcsp, rom, NULL );
+}
 
-	//ROM match (or not)
-	ds18b20match( rom );
+uint8_t ds18b20rec( uint8_t *rom )
+{
+	//Recalls DS18B20 EEPROM contents to scratchpad
 
-	//Copy scratchpad
-	onewireWrite( DS18B20_COMMAND_COPY_SP );
+	return ds18b20exec( &ds18b20txrec, rom, NULL );
+}
 
-	//Set pin high
-	//Poor DS18B20 feels better then...
-	ONEWIRE_PULLUP;
-	ONEWIRE_DIR |= ONEWIRE_TX;
+uint8_t ds18b20pwr( uint8_t *rom, uint8_t *parasite )
+{
+	//Reads DS18B20 power supply mode
+	//parasite is set to 1 if sensor is parasite powered
 
-	return DS18B20_ERROR_OK;
+	uint8_t data = 0;
+	uint8_t ec = ds18b20exec( &ds18b20txpwr, rom, &data );
+
+	*parasite = ( data & 1 ) == 0;
+	return ec;
 }
 
 uint8_t ds18b20read( uint8_t *rom, int16_t *temperature )
@@ -177,27 +210,15 @@ uint8_t ds18b20rom( uint8_t *rom )
 	//Read DS18B20 rom
 
 	unsigned char i = 0;
+	uint8_t ec = 0;
 
 	if ( rom == NULL ) return DS18B20_ERROR_OTHER;
 
-	//Communication check
-	if ( onewireInit( ) == ONEWIRE_ERROR_COMM )
-	return DS18B20_ERROR_COMM;
-
-	//Read ROM
-	onewireWrite( DS18B20_COMMAND_READ_ROM );
-	for ( i = 0; i < 8; i++ )
-	rom[i] = onewireRead( );
-
-	//Pull-up check
-	if ( ( rom[0] | rom[1] | rom[2] | rom[3] | rom[4] | rom[5] | rom[6] | rom[7] ) == 0 ) return DS18B20_ERROR_PULL;
+	ec = ds18b20exec( &ds18b20txrom, NULL, rom );
 
-	//Check CRC
-	if ( ds18b20crc8( rom, 7 ) != rom[7] )
-	{
-		for ( i = 0; i < 8; i++ ) rom[i] = 0;
-		return DS18B20_ERROR_CRC;
-	}
+	//Clear ROM on CRC error
+	if ( ec == DS18B20_ERROR_CRC )
+	for ( i = 0; i < 8; i++ ) rom[i] = 0;
 
-	return DS18B20_ERROR_OK;
+	return ec;
 }
@@ -0,0 +1,77 @@
+/*
+* histogram.cpp
+* Hours spent in each temperature band, stored in EEPROM
+* Author : Ketturi Electronics
+*/
+
+#include <avr/eeprom.h>
+#include "../include/histogram.h"
+
+#define HISTOGRAM_ERASED 0xFFFF //Value of erased EEPROM cell, read as zero
+#define HISTOGRAM_FULL   0xFFFE //Counters saturate here
+
+#if HISTOGRAM_BATCH % 60 || HISTOGRAM_BATCH > 240 || HISTOGRAM_BATCH == 0
+#error "HISTOGRAM_BATCH must be 60, 120, 180 or 240 minutes"
+#endif
+
+#if HISTOGRAM_BINS
+uint16_t EEMEM nv_histogram[HISTOGRAM_BINS]; //Hours in each band
+static uint8_t histogram_minutes[HISTOGRAM_BINS]; //Minutes not yet written to EEPROM
+
+#ifdef HISTOGRAM_STATS
+uint16_t histogram_writes = 0;
+#endif
+
+//Reads stored hours of band
+static uint16_t histogram_stored(uint8_t bin)
+{
+	uint16_t hours = eeprom_read_word(&nv_histogram[bin]);
+	
+	return hours == HISTOGRAM_ERASED ? 0 : hours;
+}
+
+//Returns band of temperature given in 1/16 degrees
+static uint8_t histogram_bin(int16_t t)
+{
+	uint16_t bin;
+	
+	if (t < HISTOGRAM_BASE*16) return 0;
+	bin = 1 + (uint16_t)(t - HISTOGRAM_BASE*16) / (HISTOGRAM_WIDTH*16);
+	return bin < HISTOGRAM_BINS ? bin : HISTOGRAM_BINS-1;
+}
+
+//Counts one minute at given temperature, band is written to EEPROM when batch is full
+void histogram_tick(int16_t t)
+{
+	uint8_t bin = histogram_bin(t);
+	uint16_t hours;
+	
+	if (++histogram_minutes[bin] < HISTOGRAM_BATCH) return;
+	histogram_minutes[bin] = 0;
+	
+	hours = histogram_stored(bin);
+	if (hours < HISTOGRAM_FULL - HISTOGRAM_BATCH/60) hours += HISTOGRAM_BATCH/60;
+	else hours = HISTOGRAM_FULL;
+	
+	eeprom_write_word(&nv_histogram[bin], hours);
+	eeprom_busy_wait(); //Wait while EEPROM is being programmed
+#ifdef HISTOGRAM_STATS
+	histogram_writes++;
+#endif
+}
+
+//Hours spent in band, including time not yet written
+uint16_t histogram_hours(uint8_t bin)
+{
+	uint16_t hours = histogram_stored(bin);
+	
+	if (hours < HISTOGRAM_FULL) hours += histogram_minutes[bin] / 60;
+	return hours;
+}
+
+//Lower edge of band in degrees
+int8_t histogram_edge(uint8_t bin)
+{
+	return HISTOGRAM_BASE + (bin-1) * HISTOGRAM_WIDTH;
+}
+#endif
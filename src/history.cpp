@@ -0,0 +1,114 @@
+/*
+* history.cpp
+* Rolling temperature history packed as 4-bit deltas
+* Author : Ketturi Electronics
+*/
+
+#include "../include/history.h"
+
+#define HISTORY_SLOTS (HISTORY_BYTES*2)
+
+#if HISTORY_DECIMATE > 8
+#error "HISTORY_DECIMATE above 8 does not fit reading counter"
+#endif
+
+#if HISTORY_BYTES
+static uint8_t history_data[HISTORY_BYTES]; //Packed deltas, two per byte
+static uint8_t history_head = 0;	//Next delta slot
+static uint8_t history_len = 0;		//Number of samples stored
+static int16_t history_first;		//Oldest sample, base for deltas
+static int16_t history_last;		//Newest sample as decoded from deltas
+static int16_t history_lo;			//Lowest sample in window
+static int16_t history_hi;			//Highest sample in window
+static int32_t history_sum;			//Sum of samples in window, average is kept without rescan
+static int32_t history_acc;			//Readings summed for next sample
+static uint8_t history_accn;		//Number of summed readings, wraps at 256
+
+//Reads signed delta from slot
+static int8_t history_getdelta(uint8_t slot)
+{
+	uint8_t d = history_data[slot >> 1];
+	
+	if (slot & 1) d >>= 4;
+	d &= 0x0F;
+	return (d & 0x08) ? (int8_t)d - 16 : d;
+}
+
+//Writes signed delta into slot
+static void history_setdelta(uint8_t slot, int8_t delta)
+{
+	uint8_t *p = &history_data[slot >> 1];
+	
+	if (slot & 1) *p = (*p & 0x0F) | (delta << 4);
+	else *p = (*p & 0xF0) | (delta & 0x0F);
+}
+
+//Decodes window from oldest sample and updates its minimum and maximum
+static void history_scan()
+{
+	int16_t t = history_first;
+	uint8_t n = history_len - 1;
+	uint8_t slot = history_head + HISTORY_SLOTS - n; //Delta after oldest sample
+	
+	if (slot >= HISTORY_SLOTS) slot -= HISTORY_SLOTS;
+	history_lo = history_hi = t;
+	
+	while (n--){
+		t += history_getdelta(slot) << HISTORY_SHIFT;
+		if (t < history_lo) history_lo = t;
+		if (t > history_hi) history_hi = t;
+		if (++slot >= HISTORY_SLOTS) slot = 0;
+	}
+}
+
+//Adds a reading, every 2^HISTORY_DECIMATE readings are stored as one sample
+void history_add(int16_t t)
+{
+	int16_t sample, delta;
+	
+	if (history_len == 0){ //First reading is stored at once
+		history_first = history_last = t;
+		history_lo = history_hi = history_sum = t;
+		history_len = 1;
+		return;
+	}
+	
+	history_acc += t;
+	if (++history_accn & ((1 << HISTORY_DECIMATE) - 1)) return;
+	sample = history_acc >> HISTORY_DECIMATE;
+	history_acc = 0;
+	
+	//Delta is taken against decoded value, so rounding errors do not add up
+	delta = (sample - history_last + (1 << (HISTORY_SHIFT-1))) >> HISTORY_SHIFT;
+	if (delta > 7) delta = 7;
+	if (delta < -8) delta = -8;
+	
+	if (history_len > HISTORY_SLOTS){ //Full, drop oldest sample
+		history_sum -= history_first;
+		history_first += history_getdelta(history_head) << HISTORY_SHIFT;
+	}
+	else history_len++;
+	
+	history_setdelta(history_head, delta);
+	if (++history_head >= HISTORY_SLOTS) history_head = 0;
+	
+	history_last += delta << HISTORY_SHIFT;
+	history_sum += history_last;
+	history_scan();
+}
+
+int16_t history_min()
+{
+	return history_lo;
+}
+
+int16_t history_max()
+{
+	return history_hi;
+}
+
+int16_t history_avg()
+{
+	return history_sum / history_len;
+}
+#endif
@@ -0,0 +1,42 @@
+/*
+* lagcomp.cpp
+* Estimates true temperature from lagging sensor in thermowell
+* Author : Ketturi Electronics
+*/
+
+#include "../include/lagcomp.h"
+#include "../include/clock.h"
+
+#if LAG_TAU
+static int32_t lag_avg;			//Reading averaged with time constant tau << LAG_SHIFT
+static uint16_t lag_time;		//Timestamp of previous reading
+static uint8_t lag_valid = 0;	//Previous reading is set
+#endif
+
+//Returns estimate of true temperature for reading taken at timestamp (clock ticks)
+int16_t lag_update(int16_t t, uint16_t timestamp)
+{
+#if LAG_TAU
+	uint16_t dt = timestamp - lag_time;
+	int32_t diff = ((int32_t)t << LAG_SHIFT) - lag_avg;
+	int16_t boost = 0;
+	
+	if (lag_valid){
+		//Average lags a steady slope by tau, so distance to it is tau * dT/dt.
+		//Single LSB steps move it by one LSB, not tau times that.
+		uint16_t w = dt >= LAG_TAU*CLOCK_HZ ? 1 << LAG_WEIGHT : ((uint32_t)dt << LAG_WEIGHT) / (LAG_TAU*CLOCK_HZ);
+		lag_avg += (diff * w) >> LAG_WEIGHT;
+		boost = diff >> LAG_SHIFT; //Rounded down, quantization noise does not raise maximum
+		if (boost > LAG_LIMIT) boost = LAG_LIMIT;
+		if (boost < -LAG_LIMIT) boost = -LAG_LIMIT;
+	}
+	else lag_avg = (int32_t)t << LAG_SHIFT;
+	lag_time = timestamp;
+	lag_valid = 1;
+	
+	return t + boost;
+#else
+	(void)timestamp;
+	return t;
+#endif
+}
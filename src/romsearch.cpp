@@ -42,6 +42,17 @@ static inline void arrbitw( uint8_t *arr, uint8_t n, uint8_t val )
 		arr[n >> 3] &= ~( 1 << ( n & 7 ) );
 }
 
+static inline uint8_t arrany( uint8_t *arr, uint8_t len )
+{
+	//Checks if any bit is set in `arr` array of `len` bytes length
+
+	uint8_t ans = 0;
+
+	while ( len-- )
+		ans |= arr[len];
+
+	return ans != 0;
+}
 
 static inline uint8_t ckolder( uint8_t *arr, uint8_t len, uint16_t n )
 {
@@ -60,12 +71,11 @@ static inline uint8_t ckolder( uint8_t *arr, uint8_t len, uint16_t n )
 	return ans != 0;
 }
 
-uint8_t ds18b20search( uint8_t *romcnt, uint8_t *roms, uint16_t buflen )
+static uint8_t ds18b20find( uint8_t command, uint8_t *romcnt, uint8_t *roms, uint16_t buflen )
 {
 	uint8_t i, bit, currom = 0;
 	uint8_t junction[8] = {0};
 	uint8_t sreg = SREG;
-	uint64_t *jun = (uint64_t*) junction; //Not to break strict aliasing rules (or at least skip the warning)
 
 	if ( romcnt == NULL ) return DS18B20_ERROR_OTHER;
 
@@ -80,7 +90,7 @@ uint8_t ds18b20search( uint8_t *romcnt, uint8_t *roms, uint16_t buflen )
 			SREG = sreg;
 			return DS18B20_ERROR_COMM;
 		}
-		onewireWrite( DS18B20_COMMAND_SEARCH_ROM );
+		onewireWrite( command );
 
 		for ( i = 0; i < 64; i++ )
 		{
@@ -137,7 +147,7 @@ uint8_t ds18b20search( uint8_t *romcnt, uint8_t *roms, uint16_t buflen )
 				arrbitw( &roms[currom << 3], i, bit );
 			}
 		}
-	} while ( ++currom && *jun );
+	} while ( ++currom && arrany( junction, 8 ) );
 
 	*romcnt = currom;
 	SREG = sreg;
@@ -145,3 +155,17 @@ uint8_t ds18b20search( uint8_t *romcnt, uint8_t *roms, uint16_t buflen )
 
 	return DS18B20_ERROR_OK;
 }
+
+uint8_t ds18b20search( uint8_t *romcnt, uint8_t *roms, uint16_t buflen )
+{
+	//Finds all sensors on bus
+
+	return ds18b20find( DS18B20_COMMAND_SEARCH_ROM, romcnt, roms, buflen );
+}
+
+uint8_t ds18b20asearch( uint8_t *romcnt, uint8_t *roms, uint16_t buflen )
+{
+	//Finds sensors with alarm flag set
+
+	return ds18b20find( DS18B20_COMMAND_ALARM_SEARCH, romcnt, roms, buflen );
+}
@@ -0,0 +1,45 @@
+################################################################################
+# footprint.mk - LTO firmware build with flash/SRAM/stack budget report
+#
+# Usage (from repository root, avr-gcc toolchain in PATH):
+#   make -f tools/footprint.mk
+#   make -f tools/footprint.mk FLASH_BUDGET=1900 SRAM_BUDGET=120
+#   make -f tools/footprint.mk FEATURES="-DHISTORY_BYTES=16 -DFAST_START=1"
+#
+# Build fails when flash, EEPROM or SRAM (static data + worst-case stack,
+# including deepest interrupt) exceeds its budget. Optional features are
+# left out unless enabled with FEATURES, see README.
+################################################################################
+
+MCU := attiny2313
+F_CPU := 4000000UL
+TOOLPREFIX ?= avr-
+PYTHON ?= python3
+
+FLASH_BUDGET ?= 2048
+SRAM_BUDGET ?= 128
+EEPROM_BUDGET ?= 128
+FEATURES ?=
+
+BUILD := footprint
+TARGET := $(BUILD)/1WireTempDisp.elf
+SRCS := main.cpp $(wildcard src/*.cpp)
+
+CXXFLAGS := -mmcu=$(MCU) -DF_CPU=$(F_CPU) -DNDEBUG -Os -flto -std=gnu++14 \
+	-funsigned-char -funsigned-bitfields -fpack-struct -fshort-enums \
+	-ffunction-sections -fdata-sections -Wall -Werror=overflow $(FEATURES)
+LDFLAGS := -mmcu=$(MCU) -Os -flto -Wl,--gc-sections -Wl,-Map=$(BUILD)/1WireTempDisp.map
+
+.PHONY: all clean FORCE
+
+all: $(TARGET)
+	$(TOOLPREFIX)size $(TARGET)
+	$(PYTHON) tools/footprint.py --prefix=$(TOOLPREFIX) \
+		--flash=$(FLASH_BUDGET) --sram=$(SRAM_BUDGET) --eeprom=$(EEPROM_BUDGET) $(TARGET)
+
+$(TARGET): $(SRCS) $(wildcard include/*.h include/*/*.h) FORCE
+	@mkdir -p $(BUILD)
+	$(TOOLPREFIX)g++ $(CXXFLAGS) $(LDFLAGS) -o $@ $(SRCS)
+
+clean:
+	rm -rf $(BUILD)
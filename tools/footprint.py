@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""footprint.py - flash/SRAM/stack report for AVR firmware
+
+Prints per-symbol flash and RAM sizes, stack frame of each function and
+worst-case stack depth of main and every interrupt vector, computed from the
+call graph in the disassembly. Exits with status 1 when a budget is exceeded.
+
+SRAM use is static data (.data + .bss) + deepest main call chain + deepest
+interrupt handler. Interrupts do not nest, so one handler is added on top.
+Indirect calls (icall/ijmp) can not be followed and are reported.
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+
+RETURN_ADDRESS = 2  # ATtiny2313 program counter is pushed as 2 bytes
+
+HEADER = re.compile(r'^[0-9a-f]+ <(.+)>:$')
+INSN = re.compile(r'^\s*[0-9a-f]+:\s+(?:[0-9a-f]{2} )+\s*(\S+)\s*([^;]*)(?:;.*<([^>]+)>)?')
+
+
+def run(tool, *args):
+    return subprocess.run([tool] + list(args), check=True,
+                          stdout=subprocess.PIPE, universal_newlines=True).stdout
+
+
+def demangle(prefix, names):
+    try:
+        out = run(prefix + 'c++filt', *names).splitlines()
+        return dict(zip(names, out))
+    except (OSError, subprocess.CalledProcessError):
+        return {n: n for n in names}
+
+
+def section_sizes(prefix, elf):
+    sizes = {}
+    for line in run(prefix + 'objdump', '-h', elf).splitlines():
+        f = line.split()
+        if len(f) > 3 and f[1].startswith('.'):
+            sizes[f[1]] = int(f[2], 16)
+    return sizes
+
+
+def symbols(prefix, elf):
+    # Returns (flash, ram) lists of (size, name)
+    flash, ram = [], []
+    for line in run(prefix + 'nm', '-S', '--size-sort', elf).splitlines():
+        f = line.split()
+        if len(f) != 4:
+            continue
+        size, kind, name = int(f[1], 16), f[2].lower(), f[3]
+        if kind in 'tw':
+            flash.append((size, name))
+        elif kind in 'dbv':
+            ram.append((size, name))
+        elif kind == 'r':
+            flash.append((size, name))
+    return sorted(flash, reverse=True), sorted(ram, reverse=True)
+
+
+def functions(prefix, elf):
+    # Returns {name: (frame bytes, set of calls, set of tail jumps, indirect)}
+    # Frame pointer adjustment counts only in the prologue, where it is followed
+    # by out __SP_L__. The epilogue frees the frame with subi r28,-N (or adiw),
+    # and frameless functions may use r28 as a plain register.
+    funcs = {}
+    name = None
+    adjust, framed = 0, False
+    for line in run(prefix + 'objdump', '-d', elf).splitlines():
+        m = HEADER.match(line)
+        if m:
+            name = m.group(1)
+            funcs[name] = [0, set(), set(), False]
+            adjust, framed = 0, False
+            continue
+        m = INSN.match(line)
+        if not m or name is None:
+            continue
+        op, args, target = m.group(1), m.group(2).strip(), m.group(3)
+        info = funcs[name]
+        if op == 'push':
+            info[0] += 1
+        elif op == 'rcall' and args == '.+0':
+            info[0] += 2  # gcc allocates small frames with rcall .+0
+        elif op in ('subi', 'sbiw') and args.startswith('r28') and not framed:
+            adjust = int(args.split(',')[1], 0) & 0xFF
+        elif op == 'out' and re.match(r'(0x3d|__SP_L__)\b', args, re.I) and not framed:
+            info[0] += adjust
+            framed = True
+        elif op in ('rcall', 'call') and target and '+' not in target:
+            info[1].add(target)
+        elif op in ('rjmp', 'jmp') and target and '+' not in target and target != name:
+            info[2].add(target)
+        elif op in ('icall', 'ijmp', 'eicall', 'eijmp'):
+            info[3] = True
+    return funcs
+
+
+def depth(funcs, name, memo, path):
+    # Worst-case stack depth of call chain starting at name
+    if name in memo:
+        return memo[name]
+    if name in path:
+        raise RecursionError(' -> '.join(path + [name]))
+    frame, calls, jumps, _ = funcs.get(name, (0, (), (), False))
+    deepest = 0
+    for callee in calls:
+        deepest = max(deepest, RETURN_ADDRESS + depth(funcs, callee, memo, path + [name]))
+    for callee in jumps:
+        if callee in funcs and not callee.startswith('__vector'):
+            deepest = max(deepest, depth(funcs, callee, memo, path + [name]))
+    memo[name] = frame + deepest
+    return memo[name]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('elf')
+    ap.add_argument('--prefix', default='avr-')
+    ap.add_argument('--flash', type=int, default=2048)
+    ap.add_argument('--sram', type=int, default=128)
+    ap.add_argument('--eeprom', type=int, default=128)
+    opt = ap.parse_args()
+
+    sec = section_sizes(opt.prefix, opt.elf)
+    flash_syms, ram_syms = symbols(opt.prefix, opt.elf)
+    funcs = functions(opt.prefix, opt.elf)
+    names = demangle(opt.prefix, sorted(set(funcs) | {n for _, n in flash_syms + ram_syms}))
+
+    print('Flash by symbol')
+    for size, name in flash_syms:
+        print('%6d  %s' % (size, names.get(name, name)))
+    print('\nRAM by symbol')
+    for size, name in ram_syms:
+        print('%6d  %s' % (size, names.get(name, name)))
+
+    memo = {}
+    try:
+        print('\nStack (frame / worst-case chain)')
+        for name in sorted(funcs):
+            print('%6d %6d  %s%s' % (funcs[name][0], depth(funcs, name, memo, []),
+                                     names.get(name, name),
+                                     '  [indirect call]' if funcs[name][3] else ''))
+    except RecursionError as e:
+        print('Recursion, stack depth unbounded: %s' % e)
+        return 1
+
+    main_depth = depth(funcs, 'main', memo, []) if 'main' in funcs else 0
+    vectors = [n for n in funcs if n.startswith('__vector')]
+    isr_depth = max([RETURN_ADDRESS + depth(funcs, n, memo, []) for n in vectors] or [0])
+
+    flash = sec.get('.text', 0) + sec.get('.data', 0)
+    static = sec.get('.data', 0) + sec.get('.bss', 0) + sec.get('.noinit', 0)
+    sram = static + main_depth + isr_depth
+    eeprom = sec.get('.eeprom', 0)
+
+    print('\nBudget')
+    failed = False
+    for label, used, budget in (('flash', flash, opt.flash),
+                                ('sram', sram, opt.sram),
+                                ('eeprom', eeprom, opt.eeprom)):
+        over = used > budget
+        failed |= over
+        print('%-7s %5d / %5d %s' % (label, used, budget, 'OVER BUDGET' if over else 'ok'))
+    print('        sram = %d static + %d main stack + %d worst ISR stack'
+          % (static, main_depth, isr_depth))
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
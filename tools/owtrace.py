@@ -0,0 +1,312 @@
+#!/usr/bin/env python3
+"""owtrace.py - 1-Wire bus trace decoder
+
+Decodes recorded 1-Wire line transitions into transactions (reset/presence,
+ROM commands, function commands, data bytes, CRC status) and checks timing
+of every slot against DS18B20 datasheet limits, printing the margin left.
+
+Input is a VCD file, for example from simavr with the onewire pins traced:
+  simavr -m attiny2313 -f 4000000 --add-vcd-trace pind=trace@0x30 \
+         --add-vcd-trace portd=trace@0x32 1WireTempDisp.elf
+  owtrace.py trace.vcd --line pind:0 --tx portd:1
+or a text file with one "time_us level" pair per line (logic analyzer export).
+Text rows may have two more columns, "time_us level tx sample": master TX
+level and 1 where master read the line. The soak simulator writes these,
+see tools/soak.mk.
+
+--line selects the bus level (RX pin, PD0). --tx is optional master TX pin
+(PD1, low pulls bus down); with it read slots are told apart from bus level
+and master release time is checked separately from slave hold time. With
+sample times the point where master reads a slot is checked against T_RDV
+and presence sampling against the window where presence pulse is certain.
+Exit status is 1 if any slot is out of spec.
+"""
+
+import argparse
+import bisect
+import re
+import sys
+
+# DS18B20 timing limits in microseconds
+T_RSTL_MIN = 480.0     # reset low
+T_PDHIGH = (15.0, 60.0)  # presence wait after reset release
+T_PDLOW = (60.0, 240.0)  # presence pulse
+T_LOW1 = (1.0, 15.0)   # write 1 low / read slot master low
+T_LOW0 = (60.0, 120.0)  # write 0 low
+T_RDV = 15.0           # read data valid from slot start
+T_MSP = (T_PDHIGH[1], T_PDHIGH[0] + T_PDLOW[0])  # presence is certain after reset release
+T_SLOT_MIN = 60.0      # slot length
+T_REC_MIN = 1.0        # recovery between slots
+
+ROM_COMMANDS = {0x33: 'READ ROM', 0x55: 'MATCH ROM', 0xCC: 'SKIP ROM',
+                0xF0: 'SEARCH ROM', 0xEC: 'ALARM SEARCH'}
+FUNCTION_COMMANDS = {0x44: 'CONVERT T', 0xBE: 'READ SCRATCHPAD', 0x4E: 'WRITE SCRATCHPAD',
+                     0x48: 'COPY SCRATCHPAD', 0xB8: 'RECALL E2', 0xB4: 'READ POWER SUPPLY'}
+
+SCALE = {'s': 1e6, 'ms': 1e3, 'us': 1.0, 'ns': 1e-3, 'ps': 1e-6, 'fs': 1e-9}
+
+
+def crc8(data):
+    crc = 0
+    for byte in data:
+        for _ in range(8):
+            mix = (crc ^ byte) & 1
+            crc >>= 1
+            if mix:
+                crc ^= 0x8C
+            byte >>= 1
+    return crc
+
+
+def parse_signal(spec):
+    name, _, bit = spec.partition(':')
+    return name, int(bit) if bit else None
+
+
+def read_vcd(path, signals):
+    """Returns {spec: [(time_us, level)]} for requested name[:bit] specs"""
+    text = open(path).read()
+    m = re.search(r'\$timescale\s+(\d+)\s*(\w+)\s+\$end', text)
+    unit = int(m.group(1)) * SCALE[m.group(2)] if m else 1e-3
+    ids = {}
+    for m in re.finditer(r'\$var\s+\S+\s+\d+\s+(\S+)\s+(\S+)(?:\s+\[[^\]]*\])?\s+\$end', text):
+        ids.setdefault(m.group(2), m.group(1))
+    wanted = {}
+    for spec in signals:
+        name, bit = parse_signal(spec)
+        if name not in ids:
+            sys.exit('signal %s not in %s (have: %s)' % (name, path, ', '.join(sorted(ids))))
+        wanted.setdefault(ids[name], []).append((spec, bit))
+    out = {spec: [] for spec in signals}
+    body = text[text.index('$enddefinitions'):].split('\n', 1)[1]
+    now = 0.0
+    for tok in body.split('\n'):
+        tok = tok.strip()
+        if not tok or tok.startswith('$'):
+            continue
+        if tok[0] == '#':
+            now = int(tok[1:]) * unit
+            continue
+        if tok[0] in 'bB':
+            value, ident = tok[1:].split()
+        else:
+            value, ident = tok[0], tok[1:]
+        for spec, bit in wanted.get(ident, ()):
+            value = value.replace('x', '0').replace('z', '1')
+            level = (int(value, 2) >> bit) & 1 if bit is not None else int(value, 2) & 1
+            trace = out[spec]
+            if not trace or trace[-1][1] != level:
+                trace.append((now, level))
+    return out
+
+
+def read_text(path):
+    """Returns line trace, TX trace or None and sample times or None"""
+    trace, tx, samples = [], [], []
+    columns = 0
+    for line in open(path):
+        f = line.replace(',', ' ').split()
+        if len(f) < 2 or f[0].startswith('#'):
+            continue
+        t = float(f[0])
+        columns = max(columns, len(f))
+        for col, out in ((1, trace), (2, tx)):
+            if col < len(f):
+                level = int(f[col]) & 1
+                if not out or out[-1][1] != level:
+                    out.append((t, level))
+        if len(f) > 3 and int(f[3]):
+            samples.append(t)
+    return trace, tx if columns > 2 else None, samples if columns > 3 else None
+
+
+def low_pulses(trace):
+    """Returns [(fall, rise)] of line low periods"""
+    pulses = []
+    fall = None
+    for t, level in trace:
+        if level == 0 and fall is None:
+            fall = t
+        elif level == 1 and fall is not None:
+            pulses.append((fall, t))
+            fall = None
+    return pulses
+
+
+def master_release(tx, rises, fall):
+    """Time master TX released the line after slot starting at fall"""
+    i = bisect.bisect_right(rises, fall)
+    return rises[i] if i < len(rises) else None
+
+
+def first_sample(samples, start, end):
+    """First master sample time in [start, end), None if none"""
+    i = bisect.bisect_left(samples, start)
+    return samples[i] if i < len(samples) and samples[i] < end else None
+
+
+class Decoder:
+    def __init__(self, line, tx, samples=None):
+        self.line = line
+        self.tx = tx
+        self.tx_rises = [t for t, level in tx if level == 1] if tx else []
+        self.samples = samples
+        self.margins = {}
+        self.violations = 0
+
+    def check(self, kind, at, value, lo=None, hi=None):
+        margin = min(value - lo if lo is not None else float('inf'),
+                     hi - value if hi is not None else float('inf'))
+        self.margins.setdefault(kind, []).append(margin)
+        if margin < 0:
+            self.violations += 1
+            print('%12.3f us  %-10s %7.2f us  OUT OF SPEC by %.2f us' % (at, kind, value, -margin))
+        return margin
+
+    def slots(self):
+        """Yields ('reset', fall, presence) or ('bit', fall, value)"""
+        pulses = low_pulses(self.line)
+        i = 0
+        last_rise = None
+        while i < len(pulses):
+            fall, rise = pulses[i]
+            width = rise - fall
+            end = pulses[i + 1][0] if i + 1 < len(pulses) else float('inf')
+            if width > T_LOW0[1] * 2:
+                self.check('reset', fall, width, T_RSTL_MIN)
+                if self.samples is not None:
+                    at = first_sample(self.samples, rise, rise + T_RSTL_MIN)
+                    if at is not None:
+                        self.check('pres.sample', rise, at - rise, *T_MSP)
+                presence = False
+                if i + 1 < len(pulses) and pulses[i + 1][0] - rise < T_PDHIGH[1] * 2:
+                    pfall, prise = pulses[i + 1]
+                    self.check('pres.wait', pfall, pfall - rise, *T_PDHIGH)
+                    self.check('pres.low', pfall, prise - pfall, *T_PDLOW)
+                    presence = True
+                    i += 1
+                    rise = prise
+                yield 'reset', fall, presence
+            else:
+                if last_rise is not None:
+                    self.check('recovery', fall, fall - last_rise, T_REC_MIN)
+                if i + 1 < len(pulses) and pulses[i + 1][0] - fall < T_LOW0[1] * 2:
+                    self.check('slot', fall, pulses[i + 1][0] - fall, T_SLOT_MIN)
+                if self.samples is not None:
+                    at = first_sample(self.samples, fall, end)
+                    if at is not None:
+                        self.check('read.sample', fall, at - fall, None, T_RDV)
+                release = master_release(self.tx, self.tx_rises, fall) if self.tx else None
+                if release is not None and release < rise - 0.5:
+                    # Master released early and slave held line: read 0
+                    self.check('read.init', fall, release - fall, *T_LOW1)
+                    self.check('read0.hold', fall, rise - fall, T_RDV)
+                    yield 'bit', fall, 0
+                elif width < T_LOW1[1]:
+                    self.check('low1', fall, width, *T_LOW1)
+                    yield 'bit', fall, 1
+                elif width < T_LOW0[0] and not self.tx:
+                    # Too short for write 0, slave held line in read slot
+                    self.check('read0.hold', fall, width, T_RDV)
+                    yield 'bit', fall, 0
+                else:
+                    self.check('low0', fall, width, *T_LOW0)
+                    yield 'bit', fall, 0
+            last_rise = rise
+            i += 1
+
+    def transactions(self):
+        """Groups slots into [(reset time, presence, bits)]"""
+        out = []
+        for kind, t, value in self.slots():
+            if kind == 'reset':
+                out.append((t, value, []))
+            elif out:
+                out[-1][2].append(value)
+            else:
+                out.append((t, None, [value]))
+        return out
+
+
+def to_bytes(bits):
+    data = []
+    for i in range(0, len(bits) - 7, 8):
+        data.append(sum(b << n for n, b in enumerate(bits[i:i + 8])))
+    return data
+
+
+def decode(t, presence, bits):
+    if presence is None:
+        print('%12.3f us  (slots before first reset: %d)' % (t, len(bits)))
+        return
+    print('%12.3f us  RESET %s' % (t, 'presence' if presence else 'NO PRESENCE'))
+    if len(bits) < 8:
+        return
+    rom = to_bytes(bits[:8])[0]
+    print('               ROM   %s (0x%02X)' % (ROM_COMMANDS.get(rom, 'unknown'), rom))
+    pos = 8
+    if rom == 0x33:
+        data = to_bytes(bits[pos:pos + 64])
+        crc = 'ok' if len(data) == 8 and crc8(data[:7]) == data[7] else 'FAIL'
+        print('               DATA  %s  CRC %s' % (' '.join('%02X' % b for b in data), crc))
+        return
+    if rom == 0x55:
+        data = to_bytes(bits[pos:pos + 64])
+        print('               ID    %s' % ' '.join('%02X' % b for b in data))
+        pos += 64
+    elif rom in (0xF0, 0xEC):
+        triplets = bits[pos:pos + 192]
+        found = [triplets[n + 2] for n in range(0, len(triplets) - 2, 3)]
+        data = to_bytes(found)
+        crc = 'ok' if len(data) == 8 and crc8(data[:7]) == data[7] else 'incomplete'
+        print('               FOUND %s  CRC %s' % (' '.join('%02X' % b for b in data), crc))
+        return
+    if len(bits) < pos + 8:
+        return
+    func = to_bytes(bits[pos:pos + 8])[0]
+    pos += 8
+    print('               FUNC  %s (0x%02X)' % (FUNCTION_COMMANDS.get(func, 'unknown'), func))
+    rest = bits[pos:]
+    if func == 0xBE:
+        data = to_bytes(rest[:72])
+        status = 'ok' if len(data) == 9 and crc8(data[:8]) == data[8] else 'FAIL'
+        if data and not any(data):
+            status += ' (all zero, pull-up?)'
+        print('               DATA  %s  CRC %s' % (' '.join('%02X' % b for b in data), status))
+    elif func == 0x4E:
+        data = to_bytes(rest[:24])
+        print('               DATA  %s' % ' '.join('%02X' % b for b in data))
+    elif rest:
+        done = rest.index(1) if 1 in rest else None
+        print('               POLL  %d slots, %s' % (len(rest), 'done after %d' % (done + 1) if done is not None else 'busy'))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('trace', help='VCD file or text file of "time_us level" lines')
+    ap.add_argument('--line', default='pind:0', help='bus level signal name[:bit] in VCD')
+    ap.add_argument('--tx', help='master TX signal name[:bit] in VCD, low drives bus down')
+    opt = ap.parse_args()
+
+    if opt.trace.endswith('.vcd'):
+        specs = [opt.line] + ([opt.tx] if opt.tx else [])
+        traces = read_vcd(opt.trace, specs)
+        line, tx = traces[opt.line], traces.get(opt.tx) if opt.tx else None
+        samples = None
+    else:
+        line, tx, samples = read_text(opt.trace)
+
+    dec = Decoder(line, tx, samples)
+    for t, presence, bits in dec.transactions():
+        decode(t, presence, bits)
+
+    print('\nTiming margins (us)      min      avg   slots')
+    for kind in sorted(dec.margins):
+        m = dec.margins[kind]
+        print('  %-18s %8.2f %8.2f %7d' % (kind, min(m), sum(m) / len(m), len(m)))
+    print('Out of spec: %d' % dec.violations)
+    return 1 if dec.violations else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,46 @@
+################################################################################
+# soak.mk - host build of firmware on simulated hardware, runs soak profiles
+#
+# Usage (from repository root, host g++):
+#   make -f tools/soak.mk
+#   make -f tools/soak.mk PROFILES="chiller noisy"
+#
+# The 30-day profile (month) takes about a minute and a half.
+#
+# After the profiles bus traffic of power-on and first readings is recorded
+# to soak/trace.txt and checked with tools/owtrace.py (python3).
+#
+# Firmware sources are built against stub AVR headers in tools/soak, with
+# all optional features and CLOCK_STATS and HISTOGRAM_STATS counters
+# enabled. Fails when a profile check fails.
+################################################################################
+
+F_CPU := 4000000UL
+CXX := g++
+
+BUILD := soak
+TARGET := $(BUILD)/soak
+FW_SRCS := $(wildcard src/*.cpp)
+SIM_SRCS := $(wildcard tools/soak/*.cpp)
+
+FEATURES := -DFAST_START=1 -DWATCHDOG_RECORD=1 -DHISTORY_BYTES=16 -DHISTOGRAM_BINS=12 -DCALIB_SENSORS=2 -DLAG_TAU=20
+
+CXXFLAGS := -std=gnu++14 -O2 -g -Wall -funsigned-char -Itools/soak \
+	-DF_CPU=$(F_CPU) -DCLOCK_STATS -DHISTOGRAM_STATS $(FEATURES)
+
+.PHONY: all clean
+
+all: $(TARGET)
+	./$(TARGET) $(PROFILES)
+	./$(TARGET) --trace $(BUILD)/trace.txt
+	python3 tools/owtrace.py $(BUILD)/trace.txt
+
+$(BUILD)/main.o: main.cpp tools/soak.mk $(wildcard include/*.h include/*/*.h tools/soak/*.h tools/soak/*/*.h)
+	@mkdir -p $(BUILD)
+	$(CXX) $(CXXFLAGS) -Dmain=firmware_main -Wno-return-type -c -o $@ main.cpp
+
+$(TARGET): $(BUILD)/main.o tools/soak.mk $(FW_SRCS) $(SIM_SRCS) $(wildcard include/*.h include/*/*.h tools/soak/*.h tools/soak/*/*.h)
+	$(CXX) $(CXXFLAGS) -o $@ $(BUILD)/main.o $(FW_SRCS) $(SIM_SRCS) -lm
+
+clean:
+	rm -rf $(BUILD)
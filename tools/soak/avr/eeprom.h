@@ -0,0 +1,27 @@
+/*
+* avr/eeprom.h
+* EEPROM for host soak test. EEMEM variables are collected to section
+* sim_eeprom, their offsets there are EEPROM addresses.
+* Author: Ketturi Electronics
+*/
+
+
+#ifndef sim_eeprom_H_
+#define sim_eeprom_H_
+
+#include <stdint.h>
+#include "../sim.h"
+
+#define EEMEM __attribute__((section("sim_eeprom"), used))
+
+//functions
+extern uint8_t eeprom_read_byte(const uint8_t *);
+extern uint16_t eeprom_read_word(const uint16_t *);
+extern void eeprom_write_byte(uint8_t *, uint8_t);
+extern void eeprom_write_word(uint16_t *, uint16_t);
+extern void eeprom_update_byte(uint8_t *, uint8_t);
+extern void eeprom_update_word(uint16_t *, uint16_t);
+
+#define eeprom_busy_wait() sim_eeprom_busy_wait()
+
+#endif /* sim_eeprom_H_ */
@@ -0,0 +1,23 @@
+/*
+* avr/interrupt.h
+* Interrupt vectors for host soak test, dispatched by sim.cpp
+* Author: Ketturi Electronics
+*/
+
+
+#ifndef sim_interrupt_H_
+#define sim_interrupt_H_
+
+#include "io.h"
+
+#define ISR(vector) extern "C" void vector(void)
+
+#define TIMER0_COMPA_vect	sim_vector_timer0
+#define TIMER1_COMPA_vect	sim_vector_timer1
+#define INT0_vect			sim_vector_int0
+#define WDT_OVERFLOW_vect	sim_vector_wdt
+
+#define cli() sim_cli()
+#define sei() sim_sei()
+
+#endif /* sim_interrupt_H_ */
@@ -0,0 +1,92 @@
+/*
+* avr/io.h
+* ATtiny2313 registers for host soak test, see sim.h
+* Author: Ketturi Electronics
+*/
+
+
+#ifndef sim_io_H_
+#define sim_io_H_
+
+#include <stdint.h>
+#include "../sim.h"
+
+#define DDRA	sim_reg.ddr[SIM_PORTA]
+#define PORTA	sim_reg.port[SIM_PORTA]
+#define PINA	(*sim_pin(SIM_PORTA))
+#define DDRB	sim_reg.ddr[SIM_PORTB]
+#define PORTB	sim_reg.port[SIM_PORTB]
+#define PINB	(*sim_pin(SIM_PORTB))
+#define DDRD	sim_reg.ddr[SIM_PORTD]
+#define PORTD	sim_reg.port[SIM_PORTD]
+#define PIND	(*sim_pin(SIM_PORTD))
+
+#define SREG	sim_reg.sreg
+#define OCR0A	sim_reg.ocr0a
+#define TCCR0A	sim_reg.tccr0a
+#define TCCR0B	sim_reg.tccr0b
+#define TIFR	sim_reg.tifr
+#define TIMSK	sim_reg.timsk
+#define GIMSK	sim_reg.gimsk
+#define MCUCR	sim_reg.mcucr
+#define MCUSR	sim_reg.mcusr
+#define WDTCSR	sim_reg.wdtcsr
+#define TCCR1A	sim_reg.tccr1a
+#define TCCR1B	sim_reg.tccr1b
+#define OCR1A	sim_reg.ocr1a
+#define TCNT1	(*sim_tcnt1())
+
+//SREG
+#define SREG_I	7
+
+//MCUSR
+#define WDRF	3
+#define BORF	2
+#define EXTRF	1
+#define PORF	0
+
+//WDTCSR
+#define WDIF	7
+#define WDIE	6
+#define WDP3	5
+#define WDCE	4
+#define WDE		3
+#define WDP2	2
+#define WDP1	1
+#define WDP0	0
+
+//TIMSK
+#define OCIE1A	6
+#define OCIE0A	0
+
+//TCCR1B
+#define WGM12	3
+#define CS12	2
+#define CS11	1
+#define CS10	0
+
+//GIMSK and MCUCR
+#define INT0	6
+#define ISC01	1
+#define ISC00	0
+
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+
+#endif /* sim_io_H_ */
@@ -0,0 +1,17 @@
+/*
+* avr/pgmspace.h
+* Flash data is ordinary memory in host soak test
+* Author: Ketturi Electronics
+*/
+
+
+#ifndef sim_pgmspace_H_
+#define sim_pgmspace_H_
+
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+
+#endif /* sim_pgmspace_H_ */
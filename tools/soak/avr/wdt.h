@@ -0,0 +1,15 @@
+/*
+* avr/wdt.h
+* Watchdog for host soak test, timeouts are handled in sim.cpp
+* Author: Ketturi Electronics
+*/
+
+
+#ifndef sim_wdt_H_
+#define sim_wdt_H_
+
+#include "io.h"
+
+#define wdt_reset() sim_wdt_reset()
+
+#endif /* sim_wdt_H_ */
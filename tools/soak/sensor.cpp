@@ -0,0 +1,251 @@
+/*
+* sensor.cpp
+* DS18B20 model answering 1-Wire slots on a simulated bus lane
+* Author : Ketturi Electronics
+*
+* Slots are decoded from master drive edges: low pulse of reset length
+* starts presence pulse, shorter pulses are write slots sampled 30us after
+* falling edge. When sending, a 0 bit holds the line low for 30us from the
+* falling edge of the read slot. Search ROM is not modelled.
+*/
+
+#include <math.h>
+#include "sim.h"
+
+#define SENSOR_RESET_US		480.0	//Shortest reset pulse
+#define SENSOR_SAMPLE_US	30.0	//Written bit is sampled this long after falling edge
+#define SENSOR_HOLD_US		30.0	//Sent 0 holds line this long after falling edge
+#define SENSOR_PRESENCE_US	30.0	//Wait before presence pulse
+#define SENSOR_PULSE_US		120.0	//Presence pulse length
+#define SENSOR_CONVERT_US	93750.0	//9-bit conversion time, doubles for each extra bit
+
+enum { SENSOR_IDLE, SENSOR_ROM, SENSOR_MATCH, SENSOR_FUNC, SENSOR_WSP, SENSOR_SEND, SENSOR_POLL };
+
+static uint8_t sensor_crc8(const uint8_t *data, uint8_t length)
+{
+	uint8_t crc = 0;
+
+	for (uint8_t i = 0; i < length; i++){
+		uint8_t byte = data[i];
+		for (uint8_t j = 0; j < 8; j++){
+			uint8_t mix = (crc ^ byte) & 1;
+			crc >>= 1;
+			if (mix) crc ^= 0x8C;
+			byte >>= 1;
+		}
+	}
+	return crc;
+}
+
+//Uniform random number [0,1) for bit errors
+static double sensor_random(sim_sensor *s)
+{
+	s->seed ^= s->seed << 13;
+	s->seed ^= s->seed >> 17;
+	s->seed ^= s->seed << 5;
+	return s->seed / 4294967296.0;
+}
+
+//Moves die temperature to given second
+static void sensor_heat(sim_sensor *s, double t)
+{
+	while (s->die_time < t){
+		double dt = t - s->die_time < 1.0 ? t - s->die_time : 1.0;
+		s->die_time += dt;
+		s->die += (s->fluid(s->die_time) + s->offset - s->die) * (1.0 - exp(-dt / s->tau));
+	}
+}
+
+//Writes result of finished conversion to scratchpad
+static void sensor_settle(sim_sensor *s)
+{
+	if (!s->converting || sim->now < s->conv_done) return;
+	s->converting = 0;
+	s->sp[0] = s->conv_value & 0xFF;
+	s->sp[1] = s->conv_value >> 8;
+	s->sp[8] = sensor_crc8(s->sp, 8);
+}
+
+static void sensor_convert(sim_sensor *s)
+{
+	uint8_t res = (s->sp[4] >> 5) & 3;
+	double t;
+
+	sensor_settle(s);
+	sensor_heat(s, sim->now / 1e6);
+	t = s->die < -55 ? -55 : s->die > 125 ? 125 : s->die;
+	s->conv_value = (int16_t)floor(t * 16) & ~((1 << (3 - res)) - 1); //Unused low bits are 0
+	s->conv_start = sim->now;
+	s->conv_done = sim->now + SENSOR_CONVERT_US * (1 << res);
+	s->converting = 1;
+
+	if (res != 3) return;
+	s->conversions++;
+	if (s->last_boot == sim->boot && s->last_conv > 0){
+		double interval = (sim->now - s->last_conv) / 1e6;
+		if (s->intervals == 0 || interval < s->interval_min) s->interval_min = interval;
+		if (interval > s->interval_max) s->interval_max = interval;
+		s->interval_sum += interval;
+		s->intervals++;
+	}
+	s->last_conv = sim->now;
+	s->last_boot = sim->boot;
+}
+
+static void sensor_send(sim_sensor *s, const uint8_t *data, uint8_t length)
+{
+	for (uint8_t i = 0; i < length; i++)
+	s->out[i] = data[i];
+	s->outlen = length;
+	s->outbit = 0;
+	s->state = SENSOR_SEND;
+}
+
+//Scratchpad as after power-on, temperature register holds 85 degrees
+void sensor_poweron(sim_sensor *s)
+{
+	s->sp[0] = 0x50;
+	s->sp[1] = 0x05;
+	s->sp[2] = s->ee[0];
+	s->sp[3] = s->ee[1];
+	s->sp[4] = s->ee[2];
+	s->sp[5] = 0xFF;
+	s->sp[6] = 0x0C;
+	s->sp[7] = 0x10;
+	s->sp[8] = sensor_crc8(s->sp, 8);
+	s->state = SENSOR_IDLE;
+	s->converting = 0;
+	s->master_low = 0;
+	s->presence_from = s->presence_to = s->hold_until = 0;
+	s->die = s->fluid(sim->now / 1e6) + s->offset;
+	s->die_time = sim->now / 1e6;
+}
+
+//Handles received command byte
+static void sensor_byte(sim_sensor *s, uint8_t b)
+{
+	switch (s->state){
+		case SENSOR_ROM:
+		s->rxcount = 0;
+		if (b == 0xCC) s->state = SENSOR_FUNC;
+		else if (b == 0x55) s->state = SENSOR_MATCH;
+		else if (b == 0x33) sensor_send(s, s->rom, 8);
+		else s->state = SENSOR_IDLE;
+		break;
+
+		case SENSOR_MATCH:
+		if (b != s->rom[s->rxcount]) s->state = SENSOR_IDLE;
+		else if (++s->rxcount == 8) s->state = SENSOR_FUNC;
+		break;
+
+		case SENSOR_FUNC:
+		s->rxcount = 0;
+		switch (b){
+			case 0x44: //Convert T, read slots return 0 until done
+			sensor_convert(s);
+			s->state = SENSOR_POLL;
+			break;
+			case 0xBE: //Read scratchpad
+			sensor_settle(s);
+			if (s->converting) s->stale_reads++;
+			if (((s->sp[4] >> 5) & 3) == 3){
+				int16_t value = (int16_t)(s->sp[1] << 8 | s->sp[0]);
+				if (value > s->value_max && value != 0x0550) s->value_max = value;
+			}
+			sensor_send(s, s->sp, 9);
+			break;
+			case 0x4E: //Write scratchpad
+			s->state = SENSOR_WSP;
+			break;
+			case 0x48: //Copy scratchpad
+			s->ee[0] = s->sp[2];
+			s->ee[1] = s->sp[3];
+			s->ee[2] = s->sp[4];
+			s->state = SENSOR_POLL;
+			break;
+			case 0xB8: //Recall E2
+			s->sp[2] = s->ee[0];
+			s->sp[3] = s->ee[1];
+			s->sp[4] = s->ee[2];
+			s->sp[8] = sensor_crc8(s->sp, 8);
+			s->state = SENSOR_POLL;
+			break;
+			case 0xB4: //Read power supply, external supply answers 1
+			s->state = SENSOR_POLL;
+			break;
+			default:
+			s->state = SENSOR_IDLE;
+		}
+		break;
+
+		case SENSOR_WSP:
+		s->sp[2 + s->rxcount] = s->rxcount == 2 ? (b & 0x60) | 0x1F : b;
+		if (++s->rxcount == 3){
+			s->sp[8] = sensor_crc8(s->sp, 8);
+			s->state = SENSOR_IDLE;
+		}
+		break;
+	}
+}
+
+//Master started (low) or ended a low pulse on the lane
+void sensor_edge(sim_sensor *s, uint8_t low)
+{
+	uint8_t bit;
+
+	s->master_low = low;
+
+	if (low){
+		s->fall = sim->now;
+		if (!s->present) return;
+		if (s->state == SENSOR_SEND){
+			bit = (s->out[s->outbit >> 3] >> (s->outbit & 7)) & 1;
+			if (++s->outbit >= s->outlen * 8) s->state = SENSOR_IDLE;
+		}
+		else if (s->state == SENSOR_POLL){
+			sensor_settle(s);
+			bit = !s->converting;
+		}
+		else return;
+
+		if (s->ber > 0 && sensor_random(s) < s->ber){
+			bit ^= 1;
+			s->bit_errors++;
+		}
+		if (!bit) s->hold_until = sim->now + SENSOR_HOLD_US;
+		return;
+	}
+
+	if (!s->present) return;
+	if (sim->now - s->fall >= SENSOR_RESET_US){
+		s->state = SENSOR_ROM;
+		s->rxbits = 0;
+		s->hold_until = 0;
+		s->presence_from = sim->now + SENSOR_PRESENCE_US;
+		s->presence_to = s->presence_from + SENSOR_PULSE_US;
+		return;
+	}
+	if (s->state == SENSOR_IDLE || s->state == SENSOR_SEND || s->state == SENSOR_POLL) return;
+
+	bit = sim->now - s->fall < SENSOR_SAMPLE_US;
+	s->rxbyte = (s->rxbyte >> 1) | (bit << 7);
+	if (++s->rxbits == 8){
+		s->rxbits = 0;
+		sensor_byte(s, s->rxbyte);
+	}
+}
+
+//Level of lane at time now (us) while master drive is unchanged, 1 is high
+uint8_t sensor_line_at(sim_sensor *s, double now)
+{
+	if (s->master_low) return 0;
+	if (!s->present) return 1;
+	if (now >= s->presence_from && now < s->presence_to) return 0;
+	return now >= s->hold_until;
+}
+
+//Level of lane at current time
+uint8_t sensor_line(sim_sensor *s)
+{
+	return sensor_line_at(s, sim->now);
+}
@@ -0,0 +1,426 @@
+/*
+* sim.cpp
+* Simulated time, Timer1, watchdog, EEPROM and port pins for host soak test
+* Author : Ketturi Electronics
+*
+* Firmware runs natively, time advances only in hooks: delays, cli(), pin
+* reads and EEPROM access. A few cli() calls in a row without I/O between
+* are a busy wait on clock_ticks(), then time skips to the next event.
+* Interrupts are dispatched in hooks while SREG I bit is set. Display
+* multiplexing timer runs only while a button is held, that is when its
+* digit scan can raise INT0.
+*
+* sim_trace records one bus lane as "time_us line tx sample" rows for
+* tools/owtrace.py: a row for every change of line or master TX level and
+* for every read of the RX pin (sample 1).
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "sim.h"
+#include "avr/io.h"
+#include "avr/eeprom.h"
+
+#define SIM_PENDING_T1	(1 << 0)
+#define SIM_PENDING_WDT	(1 << 1)
+#define SIM_PENDING_T0	(1 << 2)
+#define SIM_PENDING_INT0	(1 << 3)
+#define SIM_NEVER		1e30
+
+sim_registers sim_reg;
+sim_state *sim;
+
+//Bounds of EEMEM variables, provided by linker for section sim_eeprom
+extern char __start_sim_eeprom[], __stop_sim_eeprom[];
+
+//Per boot state, starts over in every firmware process
+static uint8_t sim_pending = 0;		//Interrupts waiting for SREG I bit
+static uint8_t sim_t1_on = 0;		//Timer1 running
+static double sim_t1_last;			//Last compare match
+static double sim_t1_next;			//Next compare match
+static double sim_t0_next = SIM_NEVER;	//Next Timer0 compare match while button is held
+static double sim_wdt_start;		//Last watchdog reset or timeout
+static double sim_ee_ready = 0;		//EEPROM write finishes
+static uint8_t sim_spin = 0;		//cli() calls since last I/O
+static uint8_t sim_pins[SIM_PORTS];
+static uint16_t sim_tcnt;
+static FILE *sim_trace_file = NULL;	//Trace of one lane, NULL if not recorded
+static sim_sensor *sim_trace_lane;
+static double sim_trace_time;		//Time of last row
+static int sim_trace_state = -1;	//Line | TX << 1 in last row
+
+//Allocates state shared with firmware processes
+void sim_setup()
+{
+	sim = (sim_state *)mmap(NULL, sizeof(sim_state), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (sim == MAP_FAILED){
+		perror("mmap");
+		exit(2);
+	}
+	memset(sim, 0, sizeof(sim_state));
+}
+
+//Programs EEPROM image of EEMEM variables, rest of EEPROM is erased
+uint16_t sim_eeprom_image()
+{
+	uint16_t size = __stop_sim_eeprom - __start_sim_eeprom;
+
+	if (size > SIM_EEPROM_SIZE){
+		fprintf(stderr, "EEMEM variables take %u bytes, EEPROM has %u\n", size, SIM_EEPROM_SIZE);
+		exit(2);
+	}
+	memset(sim->eeprom, 0xFF, SIM_EEPROM_SIZE);
+	memcpy(sim->eeprom, __start_sim_eeprom, size);
+	memset(sim->eeprom_writes, 0, sizeof(sim->eeprom_writes));
+	return size;
+}
+
+//Registers after reset, called in new firmware process
+void sim_boot()
+{
+	memset((void *)&sim_reg, 0, sizeof(sim_reg));
+	sim_reg.mcusr = sim->reset_flags;
+	if (sim->reset_flags & (1 << WDRF)) sim_reg.wdtcsr = (1 << WDE); //Watchdog stays on, 16ms
+	sim->reset_flags = 0;
+	if (sim->t1_halt && sim->now >= sim->t1_halt) sim->t1_halt = 0; //Reset restarts stopped timer
+	sim->boot++;
+	sim_wdt_start = sim->now;
+	sim_ee_ready = sim->now;
+}
+
+//Ends firmware process
+void sim_finish(int code)
+{
+	if (sim->exit_hook) sim->exit_hook();
+	if (sim_trace_file) fclose(sim_trace_file);
+	fflush(stdout);
+	_exit(code);
+}
+
+double sim_now()
+{
+	return sim->now;
+}
+
+//Starts recording lane of sensor to file in this firmware process
+void sim_trace(const char *path, uint8_t sensor)
+{
+	sim_trace_file = fopen(path, "w");
+	if (!sim_trace_file){
+		perror(path);
+		exit(2);
+	}
+	fprintf(sim_trace_file, "# time_us line tx sample\n");
+	sim_trace_lane = &sim->sensor[sensor];
+}
+
+//Writes row at time t when line or master TX changed, or master sampled line
+static void sim_trace_row(double t, uint8_t sample)
+{
+	sim_sensor *s = sim_trace_lane;
+	uint8_t tx = !s->master_low;
+	int state = sensor_line_at(s, t) | tx << 1;
+
+	if (state == sim_trace_state && !sample) return;
+	fprintf(sim_trace_file, "%.3f %u %u %u\n", t, state & 1, tx, sample);
+	sim_trace_state = state;
+	sim_trace_time = t;
+}
+
+//Writes slave edges up to time t, presence pulse and held 0 end between hooks
+static void sim_trace_slave(double t)
+{
+	sim_sensor *s = sim_trace_lane;
+	double edges[3] = {s->presence_from, s->presence_to, s->hold_until};
+
+	for (uint8_t i = 0; i < 3; i++){
+		double next = t;
+		for (uint8_t j = 0; j < 3; j++)
+		if (edges[j] > sim_trace_time && edges[j] < next) next = edges[j];
+		if (next == t) break;
+		sim_trace_row(next, 0);
+		sim_trace_time = next;
+	}
+}
+
+//Reports master drive changes of bus lanes to sensor models
+static void sim_sense()
+{
+	if (sim_trace_file) sim_trace_slave(sim->now);
+	for (uint8_t n = 0; n < SIM_SENSORS; n++){
+		sim_sensor *s = &sim->sensor[n];
+		if (!s->used) continue;
+		uint8_t low = (sim_reg.ddr[s->port] & s->tx) && !(sim_reg.port[s->port] & s->tx);
+		if (low != s->master_low) sensor_edge(s, low);
+	}
+	if (sim_trace_file) sim_trace_row(sim->now, 0);
+}
+
+static const uint16_t sim_prescale[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+
+static double sim_t1_period()
+{
+	return (sim_reg.ocr1a + 1.0) * sim_prescale[sim_reg.tccr1b & 7] * 1e6 / F_CPU;
+}
+
+static double sim_t0_period()
+{
+	return (sim_reg.ocr0a + 1.0) * sim_prescale[sim_reg.tccr0b & 7] * 1e6 / F_CPU;
+}
+
+//Timer1 clock has stopped
+static uint8_t sim_t1_halted()
+{
+	return sim->t1_halt && sim->now >= sim->t1_halt;
+}
+
+//Anode pins of digits whose button is held now
+static uint8_t sim_held()
+{
+	uint8_t held = 0;
+
+	for (uint8_t n = 0; n < SIM_PRESSES; n++){
+		const sim_press *p = &sim->press[n];
+		if (p->to > 0 && sim->now >= p->from * 1e6 && sim->now < p->to * 1e6) held |= 1 << p->anode;
+	}
+	return held;
+}
+
+//Next time a button is pressed or released
+static double sim_press_event()
+{
+	double next = SIM_NEVER;
+
+	for (uint8_t n = 0; n < SIM_PRESSES; n++){
+		const sim_press *p = &sim->press[n];
+		if (p->to == 0) continue;
+		if (p->from * 1e6 > sim->now && p->from * 1e6 < next) next = p->from * 1e6;
+		if (p->to * 1e6 > sim->now && p->to * 1e6 < next) next = p->to * 1e6;
+	}
+	return next;
+}
+
+static double sim_wdt_deadline()
+{
+	uint8_t wdp = (sim_reg.wdtcsr & 7) | ((sim_reg.wdtcsr >> WDP3 & 1) << 3);
+
+	if (!(sim_reg.wdtcsr & ((1 << WDE) | (1 << WDIE)))) return SIM_NEVER;
+	return sim_wdt_start + 16000.0 * (1 << wdp);
+}
+
+//Time of next timer or watchdog event
+static double sim_next_event()
+{
+	double next = sim_wdt_deadline();
+
+	if (sim_t1_on && !sim_t1_halted() && sim_t1_next < next) next = sim_t1_next;
+	if (sim_t0_next < next) next = sim_t0_next;
+	if (sim_press_event() < next) next = sim_press_event();
+	return next < sim->end ? next : sim->end;
+}
+
+//Runs pending interrupts when enabled
+static void sim_dispatch()
+{
+	if (!(sim_reg.sreg & (1 << SREG_I)) || !sim_pending) return;
+
+	sim_reg.sreg &= ~(1 << SREG_I);
+	sim_spin = 0; //Firmware may react to interrupt, it is not waiting any more
+	if (sim_pending & SIM_PENDING_T1){
+		sim_pending &= ~SIM_PENDING_T1;
+		sim_vector_timer1();
+		if (sim->tick_hook) sim->tick_hook();
+	}
+	if (sim_pending & SIM_PENDING_WDT){
+		sim_pending &= ~SIM_PENDING_WDT;
+		sim_reg.wdtcsr &= ~(1 << WDIF);
+		sim->wdt_interrupts++;
+		sim_vector_wdt();
+	}
+	if (sim_pending & SIM_PENDING_T0){
+		sim_pending &= ~SIM_PENDING_T0;
+		sim_vector_timer0();
+
+		//Held button connects digit anode to INT0. Digit change turns previous anode off
+		//before next one on, so held button of new digit gives a rising edge.
+		uint8_t held = sim_held() & sim_reg.ddr[SIM_PORTD] & ~sim_reg.port[SIM_PORTD];
+		if (held && (sim_reg.gimsk & (1 << INT0)) && (sim_reg.mcucr & 3) == 3)
+		sim_pending |= SIM_PENDING_INT0;
+	}
+	if (sim_pending & SIM_PENDING_INT0){
+		sim_pending &= ~SIM_PENDING_INT0;
+		sim->int0_interrupts++;
+		sim_vector_int0();
+	}
+	sim_reg.sreg |= (1 << SREG_I);
+}
+
+//Advances time to t, handling timer and watchdog events on the way
+static void sim_advance(double t)
+{
+	sim_sense();
+
+	if ((sim_reg.tccr1b & 7) && !sim_t1_on){ //Timer1 started
+		sim_t1_on = 1;
+		sim_t1_last = sim->now;
+		sim_t1_next = sim->now + sim_t1_period();
+	}
+
+	do {
+		double next = sim_next_event();
+
+		if (next > t) next = t;
+		if (next > sim->now) sim->now = next;
+		if (sim->now >= sim->end) sim_finish(SIM_EXIT_END);
+
+		if (sim_t1_on && !sim_t1_halted() && sim->now >= sim_t1_next){
+			sim_t1_last = sim_t1_next;
+			sim_t1_next += sim_t1_period();
+			if (sim_reg.timsk & (1 << OCIE1A)) sim_pending |= SIM_PENDING_T1;
+		}
+		if (sim_held() && (sim_reg.tccr0b & 7)){
+			if (sim_t0_next == SIM_NEVER) sim_t0_next = sim->now + sim_t0_period();
+			else if (sim->now >= sim_t0_next){
+				sim_t0_next += sim_t0_period();
+				if (sim_reg.timsk & (1 << OCIE0A)) sim_pending |= SIM_PENDING_T0;
+			}
+		}
+		else sim_t0_next = SIM_NEVER;
+		if (sim->now >= sim_wdt_deadline()){
+			sim_wdt_start = sim->now;
+			if (sim_reg.wdtcsr & (1 << WDIE)){
+				sim_reg.wdtcsr |= (1 << WDIF);
+				if (sim_reg.wdtcsr & (1 << WDE)) sim_reg.wdtcsr &= ~(1 << WDIE); //Cleared by hardware at time-out, next one resets
+				sim_pending |= SIM_PENDING_WDT;
+			}
+			else{
+				sim->reset_flags = (1 << WDRF);
+				sim_finish(SIM_EXIT_RESET);
+			}
+		}
+		sim_dispatch();
+	} while (sim->now < t);
+}
+
+void sim_delay_us(double us)
+{
+	sim_spin = 0;
+	sim_advance(sim->now + us);
+}
+
+//Busy wait is detected here, it skips to next event
+void sim_cli()
+{
+	if (++sim_spin >= SIM_SPIN && sim_t1_on) sim_advance(sim_next_event());
+	else sim_advance(sim->now + SIM_CLI_US);
+	sim_reg.sreg &= ~(1 << SREG_I);
+}
+
+void sim_sei()
+{
+	sim_reg.sreg |= (1 << SREG_I);
+	sim_dispatch();
+}
+
+void sim_wdt_reset()
+{
+	sim_wdt_start = sim->now;
+}
+
+//Pin register of port, bus lanes read their line level
+volatile uint8_t *sim_pin(uint8_t port)
+{
+	sim_spin = 0;
+	sim_sense();
+
+	uint8_t pins = sim_reg.port[port]; //Inputs read as pull-up, outputs as driven
+	for (uint8_t n = 0; n < SIM_SENSORS; n++){
+		sim_sensor *s = &sim->sensor[n];
+		if (!s->used || s->port != port) continue;
+		if (sensor_line(s)) pins |= s->rx;
+		else pins &= ~s->rx;
+	}
+	sim_pins[port] = pins;
+	if (sim_trace_file && port == sim_trace_lane->port) sim_trace_row(sim->now, 1);
+	return &sim_pins[port];
+}
+
+//Timer1 count since last compare match, writes are ignored
+volatile uint16_t *sim_tcnt1()
+{
+	double period = sim_t1_period();
+
+	double now = sim_t1_halted() ? sim->t1_halt : sim->now;
+
+	sim_tcnt = 0;
+	if (sim_t1_on && period > 0 && now > sim_t1_last)
+	sim_tcnt = (uint16_t)((now - sim_t1_last) / period * (sim_reg.ocr1a + 1.0));
+	return &sim_tcnt;
+}
+
+//EEPROM address of EEMEM variable
+uint16_t sim_eeprom_offset(const void *p)
+{
+	long offset = (const char *)p - __start_sim_eeprom;
+
+	if (offset < 0 || offset >= SIM_EEPROM_SIZE){
+		fprintf(stderr, "EEPROM access outside EEMEM variables\n");
+		abort();
+	}
+	return offset;
+}
+
+void sim_eeprom_busy_wait()
+{
+	sim_spin = 0;
+	if (sim_ee_ready > sim->now) sim_advance(sim_ee_ready);
+}
+
+uint8_t eeprom_read_byte(const uint8_t *p)
+{
+	sim_eeprom_busy_wait();
+	return sim->eeprom[sim_eeprom_offset(p)];
+}
+
+uint16_t eeprom_read_word(const uint16_t *p)
+{
+	const uint8_t *b = (const uint8_t *)p;
+
+	return eeprom_read_byte(b) | (eeprom_read_byte(b + 1) << 8);
+}
+
+//Waits for previous write, programming continues in background
+void eeprom_write_byte(uint8_t *p, uint8_t value)
+{
+	uint16_t a = sim_eeprom_offset(p);
+
+	sim_eeprom_busy_wait();
+	sim->eeprom[a] = value;
+	sim->eeprom_writes[a]++;
+	sim_ee_ready = sim->now + SIM_EEPROM_WRITE_US;
+}
+
+void eeprom_write_word(uint16_t *p, uint16_t value)
+{
+	uint8_t *b = (uint8_t *)p;
+
+	eeprom_write_byte(b, value & 0xFF);
+	eeprom_write_byte(b + 1, value >> 8);
+}
+
+void eeprom_update_byte(uint8_t *p, uint8_t value)
+{
+	if (eeprom_read_byte(p) != value) eeprom_write_byte(p, value);
+}
+
+void eeprom_update_word(uint16_t *p, uint16_t value)
+{
+	uint8_t *b = (uint8_t *)p;
+
+	eeprom_update_byte(b, value & 0xFF);
+	eeprom_update_byte(b + 1, value >> 8);
+}
@@ -0,0 +1,134 @@
+/*
+* sim.h
+* Host simulation of ATtiny2313 peripherals used by soak test
+* Author: Ketturi Electronics
+*/
+
+
+#ifndef sim_H_
+#define sim_H_
+
+#include <stdint.h>
+
+#define SIM_EEPROM_SIZE		128		//Bytes of EEPROM
+#define SIM_EEPROM_WRITE_US	3400.0	//EEPROM byte programming time
+#define SIM_CLI_US			2.0		//CPU time charged for each cli(), firmware runs between hooks
+#define SIM_SPIN			4		//cli() calls without I/O in between that count as busy wait
+#define SIM_SENSORS			3		//Sensor models on buses
+#define SIM_PRESSES			8		//Button presses in schedule
+
+//Exit codes of firmware process
+#define SIM_EXIT_END	10	//Profile time elapsed
+#define SIM_EXIT_RESET	11	//Watchdog reset
+
+//Ports with pins readable through sim_pin
+enum { SIM_PORTA, SIM_PORTB, SIM_PORTD, SIM_PORTS };
+
+//Registers without side effects are plain memory
+struct sim_registers {
+	volatile uint8_t ddr[SIM_PORTS];
+	volatile uint8_t port[SIM_PORTS];
+	volatile uint8_t sreg;
+	volatile uint8_t ocr0a, tccr0a, tccr0b, tifr, timsk, gimsk, mcucr, mcusr, wdtcsr;
+	volatile uint8_t tccr1a, tccr1b;
+	volatile uint16_t ocr1a;
+};
+
+//DS18B20 attached to one bus lane, see sensor.cpp
+struct sim_sensor {
+	//Wiring
+	uint8_t used;
+	uint8_t port, rx, tx;	//Port and pin masks of lane
+	uint8_t present;		//Answers reset with presence pulse
+	double ber;				//Probability of flipped bit in read slot
+	uint32_t seed;			//Noise generator state
+
+	//Thermal model, die follows fluid temperature with time constant tau
+	double (*fluid)(double);	//Fluid temperature at given second
+	double offset;				//Added to fluid temperature
+	double tau;					//Seconds
+	double die;					//Die temperature
+	double die_time;			//Second of die temperature
+
+	//Bus state
+	uint8_t master_low;
+	double fall;				//Start of current low pulse, us
+	double presence_from, presence_to, hold_until;
+	uint8_t state;
+	uint8_t rxbyte, rxbits, rxcount;
+	uint8_t out[9], outlen, outbit;
+
+	//Chip state
+	uint8_t rom[8];
+	uint8_t sp[9];
+	uint8_t ee[3];				//TH, TL and configuration in sensor EEPROM
+	uint8_t converting;
+	double conv_start, conv_done;
+	int16_t conv_value;
+
+	//Statistics
+	uint32_t conversions;		//12-bit conversions started
+	uint32_t stale_reads;		//Scratchpad reads during conversion
+	uint32_t bit_errors;
+	double last_conv;			//Start of previous 12-bit conversion, us
+	uint32_t last_boot;			//Boot of previous conversion
+	double interval_min, interval_max, interval_sum;
+	uint32_t intervals;
+	int16_t value_max;			//Highest converted value, 1/16 degrees
+};
+
+//Button held between from and to, connects digit anode to INT0
+struct sim_press {
+	double from, to;			//Seconds
+	uint8_t anode;				//PORTD pin of digit, active low
+};
+
+//State shared by harness and firmware processes
+struct sim_state {
+	double now;					//Simulation time, us
+	double end;					//End of profile, us
+	uint32_t boot;				//Boots since profile start
+	uint8_t reset_flags;		//MCUSR at next boot
+	uint8_t eeprom[SIM_EEPROM_SIZE];
+	uint32_t eeprom_writes[SIM_EEPROM_SIZE];
+	uint32_t wdt_interrupts;
+	uint32_t int0_interrupts;
+	sim_press press[SIM_PRESSES];	//Unused entries have to == 0
+	double t1_halt;				//Timer1 stops counting, us, next reset clears fault, 0 if never
+	sim_sensor sensor[SIM_SENSORS];
+	void (*tick_hook)();		//Called after every Timer1 interrupt
+	void (*exit_hook)();		//Called before firmware process ends
+};
+
+extern sim_registers sim_reg;
+extern sim_state *sim;
+
+extern "C" {
+	void sim_vector_timer0(void);
+	void sim_vector_timer1(void);
+	void sim_vector_int0(void);
+	void sim_vector_wdt(void);
+}
+
+//functions
+extern void sim_setup();
+extern uint16_t sim_eeprom_image();
+extern void sim_boot();
+extern void sim_finish(int);
+extern double sim_now();
+extern void sim_delay_us(double);
+extern void sim_cli();
+extern void sim_sei();
+extern void sim_wdt_reset();
+extern volatile uint8_t *sim_pin(uint8_t);
+extern volatile uint16_t *sim_tcnt1();
+extern uint16_t sim_eeprom_offset(const void *);
+extern void sim_eeprom_busy_wait();
+extern void sim_trace(const char *, uint8_t);
+
+extern void sensor_poweron(sim_sensor *);
+extern void sensor_edge(sim_sensor *, uint8_t);
+extern uint8_t sensor_line(sim_sensor *);
+extern uint8_t sensor_line_at(sim_sensor *, double);
+
+#endif /* sim_H_ */
@@ -0,0 +1,513 @@
+/*
+* soak.cpp
+* Accelerated soak test: runs firmware on simulated hardware through
+* temperature profiles, hours of operation take seconds.
+* Author : Ketturi Electronics
+*
+* Every boot runs in its own process, so a watchdog reset starts with
+* fresh RAM while EEPROM, sensor and time live in shared memory.
+* Reports sampling cadence, EEPROM writes, maximum tracking, alarm latency,
+* button handling, histogram and resets of each profile. Exit status is 1
+* if any check fails. With --trace FILE first seconds after power-on are
+* recorded for tools/owtrace.py instead.
+* Host int is 32 bits, so overflows of 16-bit int are not reproduced here.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "sim.h"
+#include "avr/io.h"
+#include "../../include/clock.h"
+#include "../../include/histogram.h"
+#include "../../include/display.h"
+#include "../../include/watchdog.h"
+#include "../../include/ds18b20/ds18b20.h"
+
+#define SOAK_TAU		20.0	//Sensor time constant in thermowell, seconds
+#define SOAK_INTERVAL	1.0		//Expected reading interval, seconds
+#define SOAK_JITTER		0.01	//Accepted deviation of reading interval, seconds
+#define SOAK_CYCLES		100000.0	//EEPROM write endurance
+#define SOAK_LEAD		0.125	//Accepted lead of maximum over tank temperature, degrees
+#define SOAK_HOLD		0.2		//Seconds button is held
+#define SOAK_PAGE_HOLD	3		//Readings page stays after down button, PAGE_HOLD in main.cpp
+#define SOAK_FULL		0xFFFE	//Saturated histogram band, HISTOGRAM_FULL in histogram.cpp
+#define SOAK_HEADROOM	50		//Hours left in preloaded band
+#define SOAK_TRACE		2.5		//Seconds recorded with --trace
+
+#define SOAK_UP			1		//Up button, on first digit
+#define SOAK_DOWN		2		//Down button, on second digit
+
+//Two lanes clocked in lockstep, RX on PB0 and PB2, TX on PB1 and PB3
+typedef OneWireBus<OneWirePortB, ( 1 << PB0 ) | ( 1 << PB2 ), ( 1 << PB1 ) | ( 1 << PB3 )> SoakLanes;
+
+//Firmware symbols, main is renamed in build
+extern int firmware_main(void);
+extern int temp_max;
+extern uint16_t nv_temp_max;
+extern uint16_t nv_histogram[];
+extern struct wdt_record nv_wdt;
+extern uint8_t page;
+extern char buffer[];
+
+//Buttons pressed at given second
+struct soak_press {
+	double at;					//0 ends list
+	uint8_t buttons;			//SOAK_UP, SOAK_DOWN or both
+};
+
+struct soak_profile {
+	const char *name;
+	const char *about;
+	double hours;
+	double (*fluid)(double);	//Tank temperature at given second
+	double alarm;				//Alarm level in degrees, 0 if not checked
+	double latency;				//Largest accepted alarm latency, seconds
+	double ber;					//Bit error rate of bus
+	uint8_t resets;				//Resets are expected
+	const soak_press *presses;	//Button schedule, NULL if none
+	double stall;				//Second Timer1 stops and main loop stalls, 0 if never
+	double years;				//Smallest accepted life of hottest EEPROM cell, 0 if not checked
+	int8_t full_band;			//Histogram band preloaded close to saturation, -1 if none
+};
+
+//Results gathered by firmware processes
+struct soak_result {
+	double alarm_at;			//Time maximum reached alarm level, us
+	double alarm_fluid;			//Tank temperature at that time
+	int temp_max;				//Maximum in RAM at last exit
+	uint32_t late_max;			//Worst sample lateness, timer counts
+	uint32_t overruns;
+	uint32_t histogram_writes;
+	double alarm;
+	int16_t lanes[SoakLanes::Lanes];	//Temperatures read from lanes
+	uint8_t lanes_ec[SoakLanes::Lanes];
+	uint8_t lanes_failed;
+	uint32_t page_steps;		//Times a new page was shown
+	uint32_t page_strays;		//Page steps without down button
+	double page_over;			//Longest time page stayed past its timeout, seconds
+	uint8_t max_cleared;		//Maximum dropped after both buttons
+	uint8_t reported;			//Stage shown in Ed.N report + 1, 0 if none
+};
+
+static soak_result *result;
+static const uint8_t soak_rom[8] = {0x28, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x56}; //Sensor ROM ID with CRC
+static const soak_profile *soak_current;
+
+//Heater takes tank from 18 to 30 degrees with 1h time constant
+static double soak_heatup(double t)
+{
+	return t < 600 ? 18 : 18 + 12 * (1 - exp(-(t - 600) / 3600));
+}
+
+//Chiller holds 20 degrees with compressor cycling, fails after 3h and tank drifts towards 34
+static double soak_chiller(double t)
+{
+	double c = 20 + 0.3 * sin(2 * M_PI * t / 1200);
+
+	if (t > 3 * 3600) c += 14 * (1 - exp(-(t - 3 * 3600) / 1800));
+	return c;
+}
+
+//Slowly varying tank on long cable
+static double soak_steady(double t)
+{
+	return 24 + 0.5 * sin(2 * M_PI * t / 3600);
+}
+
+//Daily and weekly swing of unattended tank
+static double soak_month(double t)
+{
+	return 24 + 3 * sin(2 * M_PI * t / 86400) + 1.5 * sin(2 * M_PI * t / (7 * 86400));
+}
+
+//Pages stepped with down button and left to time out, down then up, both buttons at minimum of tank
+static const soak_press soak_panel[] = {
+	{600, SOAK_DOWN}, {601.5, SOAK_DOWN}, {603, SOAK_DOWN},
+	{900, SOAK_DOWN}, {901.5, SOAK_UP},
+	{2700, SOAK_UP | SOAK_DOWN},
+	{0, 0},
+};
+
+static const soak_profile soak_profiles[] = {
+	{"heatup", "heat-up 18 -> 30 C", 4, soak_heatup, 28, 60, 0, 0, NULL, 0, 0, -1},
+	{"chiller", "chiller failure after 3 h", 6, soak_chiller, 26, 60, 0, 0, NULL, 0, 0, -1},
+	{"noisy", "noisy bus, bit error rate 5e-5", 2, soak_steady, 0, 0, 5e-5, 1, NULL, 0, 0, -1},
+	{"buttons", "pages, up and both buttons", 2, soak_steady, 0, 0, 0, 0, soak_panel, 0, 0, -1},
+	{"stall", "Timer1 stops, main loop stalls", 1, soak_steady, 0, 0, 0, 1, NULL, 1000, 0, -1},
+	{"month", "30 days, daily swing, band 22-24 C near saturation", 30 * 24, soak_month, 0, 0, 0, 0, NULL, 0, 10, 4},
+};
+
+//Down button held at t or released less than a reading before, held button repeats once per reading
+static uint8_t soak_down(double t)
+{
+	for (const soak_press *b = soak_current->presses; b && b->at > 0; b++)
+	if (b->buttons == SOAK_DOWN && t >= b->at && t <= b->at + SOAK_HOLD + SOAK_INTERVAL) return 1;
+	return 0;
+}
+
+//Second page has to be back on live temperature after last button press before t, 0 if no press
+static double soak_page_timeout(double t)
+{
+	double timeout = 0;
+
+	for (const soak_press *b = soak_current->presses; b && b->at > 0 && b->at <= t; b++)
+	timeout = b->at + SOAK_HOLD + (b->buttons == SOAK_UP ? 1 : SOAK_PAGE_HOLD) * SOAK_INTERVAL;
+	return timeout;
+}
+
+//Called in firmware process on every clock tick
+static void soak_tick()
+{
+	static uint8_t last_page = 0;
+	static int last_max = 0;
+	double t = sim->now / 1e6;
+
+	if (result->alarm > 0 && result->alarm_at == 0 && temp_max >= result->alarm * 16)
+	{
+		result->alarm_at = sim->now;
+		result->alarm_fluid = sim->sensor[0].fluid(sim->now / 1e6);
+	}
+	if (page != last_page && page != 0){
+		result->page_steps++;
+		if (!soak_down(t)) result->page_strays++;
+	}
+	if (page != 0 && t - soak_page_timeout(t) > result->page_over) result->page_over = t - soak_page_timeout(t);
+	if (temp_max < last_max) result->max_cleared = 1;
+	if (buffer[0] == 15 && buffer[1] == 14) result->reported = buffer[2]; //Ed.N
+	last_page = page;
+	last_max = temp_max;
+}
+
+//Called before firmware process ends
+static void soak_exit()
+{
+	result->temp_max = temp_max;
+	if (clock_late_max > result->late_max) result->late_max = clock_late_max;
+	result->overruns += clock_overruns;
+	result->histogram_writes += histogram_writes;
+}
+
+//Time fluid first reaches level, seconds
+static double soak_crossing(const soak_profile *p, double level)
+{
+	for (double t = 0; t < p->hours * 3600; t += 0.1)
+	if (p->fluid(t) >= level) return t;
+	return -1;
+}
+
+//Highest tank temperature of profile
+static double soak_peak(const soak_profile *p)
+{
+	double peak = p->fluid(0);
+
+	for (double t = 0; t < p->hours * 3600; t += 0.1)
+	if (p->fluid(t) > peak) peak = p->fluid(t);
+	return peak;
+}
+
+//Number of presses with given buttons
+static uint8_t soak_presses(const soak_profile *p, uint8_t buttons)
+{
+	uint8_t n = 0;
+
+	for (const soak_press *b = p->presses; b && b->at > 0; b++)
+	if (b->buttons == buttons) n++;
+	return n;
+}
+
+static const char *soak_cell(uint16_t a, char *name)
+{
+	uint16_t max = sim_eeprom_offset(&nv_temp_max);
+	uint16_t hist = sim_eeprom_offset(nv_histogram);
+
+	if (a >= max && a < max + 2) sprintf(name, "nv_temp_max+%u", a - max);
+	else if (a >= hist && a < hist + 2 * HISTOGRAM_BINS) sprintf(name, "nv_histogram[%u]+%u", (a - hist) / 2, (a - hist) % 2);
+	else sprintf(name, "offset %u", a);
+	return name;
+}
+
+static int soak_check(int ok, const char *what)
+{
+	if (!ok) printf("  FAIL: %s\n", what);
+	return ok ? 0 : 1;
+}
+
+//Runs firmware through profile, returns number of failed checks
+static int soak_run(const soak_profile *p)
+{
+	sim_sensor *s = &sim->sensor[0];
+	uint32_t resets = 0, stalls = 0;
+	uint8_t stall_task = TASK_NONE;
+	int stall_max = 0, record_max = 0;
+	uint16_t record = sim_eeprom_offset(&nv_wdt.task);
+	uint16_t hist = sim_eeprom_offset(nv_histogram);
+	int failed = 0, status;
+
+	memset(sim->sensor, 0, sizeof(sim->sensor));
+	memset(result, 0, sizeof(soak_result));
+	sim->now = 0;
+	sim->end = p->hours * 3600e6;
+	sim->boot = 0;
+	sim->wdt_interrupts = 0;
+	sim->int0_interrupts = 0;
+	sim->t1_halt = p->stall * 1e6;
+	memset(sim->press, 0, sizeof(sim->press));
+	for (uint8_t n = 0, i = 0; p->presses && p->presses[i].at > 0; i++){
+		static const uint8_t anode[2] = {LED_CA1, LED_CA2};
+		for (uint8_t b = 0; b < 2; b++){
+			if (!(p->presses[i].buttons & (1 << b)) || n >= SIM_PRESSES) continue;
+			sim->press[n].from = p->presses[i].at;
+			sim->press[n].to = p->presses[i].at + SOAK_HOLD;
+			sim->press[n++].anode = anode[b];
+		}
+	}
+	soak_current = p;
+	sim->reset_flags = (1 << PORF);
+	sim->tick_hook = soak_tick;
+	sim->exit_hook = soak_exit;
+	sim_eeprom_image();
+	if (p->full_band >= 0){
+		sim->eeprom[hist + 2 * p->full_band] = (SOAK_FULL - SOAK_HEADROOM) & 0xFF;
+		sim->eeprom[hist + 2 * p->full_band + 1] = (SOAK_FULL - SOAK_HEADROOM) >> 8;
+	}
+	result->alarm = p->alarm;
+
+	s->used = 1;
+	s->port = SIM_PORTD;
+	s->rx = (1 << PD0);
+	s->tx = (1 << PD1);
+	s->present = 1;
+	s->ber = p->ber;
+	s->seed = 12345;
+	s->fluid = p->fluid;
+	s->tau = SOAK_TAU;
+	s->ee[0] = 0x4B;
+	s->ee[1] = 0x46;
+	s->ee[2] = 0x7F;
+	memcpy(s->rom, soak_rom, 8);
+	sensor_poweron(s);
+
+	for (;;){
+		fflush(stdout);
+		pid_t pid = fork();
+		if (pid == 0){
+			sim_boot();
+			firmware_main();
+			for (;;) sim_delay_us(1000); //Returned from main, wait for watchdog
+		}
+		waitpid(pid, &status, 0);
+		if (WIFEXITED(status) && WEXITSTATUS(status) == SIM_EXIT_RESET){
+			resets++;
+			if (sim->eeprom[record] != TASK_NONE){
+				stalls++;
+				stall_task = sim->eeprom[record];
+				stall_max = result->temp_max;
+				record = sim_eeprom_offset(&nv_wdt.max);
+				record_max = (int16_t)(sim->eeprom[record] | sim->eeprom[record + 1] << 8);
+				record = sim_eeprom_offset(&nv_wdt.task);
+			}
+			continue;
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != SIM_EXIT_END){
+			printf("  firmware process failed, status %d\n", status);
+			return 1;
+		}
+		break;
+	}
+
+	uint32_t writes = 0, hottest = 0;
+	char name[32];
+	for (uint16_t a = 0; a < SIM_EEPROM_SIZE; a++){
+		writes += sim->eeprom_writes[a];
+		if (sim->eeprom_writes[a] > sim->eeprom_writes[hottest]) hottest = a;
+	}
+	double hot_rate = sim->eeprom_writes[hottest] / p->hours;
+	double interval = s->intervals ? s->interval_sum / s->intervals : 0;
+	uint16_t a = sim_eeprom_offset(&nv_temp_max);
+	int16_t nv_max = sim->eeprom[a] | sim->eeprom[a + 1] << 8;
+
+	printf("Profile %s: %s, %.1f h\n", p->name, p->about, p->hours);
+	printf("  readings         %8u   interval %.3f s (min %.3f, max %.3f)\n",
+	s->conversions, interval, s->interval_min, s->interval_max);
+	printf("  stale reads      %8u   bit errors %u\n", s->stale_reads, s->bit_errors);
+	printf("  resets           %8u   stalled %u, watchdog interrupts %u\n", resets, stalls, sim->wdt_interrupts);
+	if (stalls)
+	printf("  stall record         Ed.%u   maximum %.2f C (RAM %.2f C), reported Ed.%u\n",
+	stall_task + 1, record_max / 16.0, stall_max / 16.0, result->reported);
+	if (p->presses)
+	printf("  buttons          %8u   INT0 interrupts %u, page steps %u (stray %u), page late %.2f s\n",
+	soak_presses(p, SOAK_UP) + soak_presses(p, SOAK_DOWN) + soak_presses(p, SOAK_UP | SOAK_DOWN),
+	sim->int0_interrupts, result->page_steps, result->page_strays, result->page_over);
+	printf("  eeprom writes    %8u   %.1f per hour, hottest %s %u (%.1f years at %.0f cycles)\n",
+	writes, writes / p->hours, soak_cell(hottest, name), sim->eeprom_writes[hottest],
+	hot_rate > 0 ? SOAK_CYCLES / hot_rate / 24 / 365 : INFINITY, SOAK_CYCLES);
+	printf("  histogram writes %8u   bands", result->histogram_writes);
+	uint32_t hours = 0, full = 0; //Hours counted in run, preloaded band
+	for (uint8_t b = 0; b < HISTOGRAM_BINS; b++){
+		uint16_t h = sim->eeprom[hist + 2 * b] | sim->eeprom[hist + 2 * b + 1] << 8;
+		if (h == 0xFFFF) h = 0; //Erased
+		printf(" %u", h);
+		if (b == p->full_band) full = h;
+		hours += b == p->full_band ? h - (SOAK_FULL - SOAK_HEADROOM) : h;
+	}
+	printf("\n");
+	double peak = soak_peak(p);
+	printf("  maximum          %8.2f C (readings %.2f C, tank %.2f C, EEPROM %.2f C)\n",
+	result->temp_max / 16.0, s->value_max / 16.0, peak, nv_max / 16.0);
+	if (p->alarm > 0){
+		double crossing = soak_crossing(p, p->alarm);
+		if (result->alarm_at > 0)
+		printf("  alarm %4.1f C     %8.1f s latency, tank %.2f C\n", p->alarm, result->alarm_at / 1e6 - crossing, result->alarm_fluid);
+		else
+		printf("  alarm %4.1f C        never\n", p->alarm);
+		failed += soak_check(result->alarm_at > 0 && result->alarm_at / 1e6 - crossing <= p->latency, "alarm latency");
+		failed += soak_check(result->alarm_at == 0 || result->alarm_fluid >= p->alarm - SOAK_LEAD, "alarm before tank reached level");
+	}
+	printf("  clock late max   %8u us, overruns %u\n", (unsigned)(result->late_max * 8 * 1000000ULL / F_CPU), result->overruns);
+
+	failed += soak_check(s->intervals > 0 && s->interval_min >= SOAK_INTERVAL - SOAK_JITTER
+	&& s->interval_max <= SOAK_INTERVAL + SOAK_JITTER, "reading interval");
+	failed += soak_check(s->stale_reads == 0, "scratchpad read during conversion");
+	failed += soak_check(p->resets || resets == 0, "unexpected reset");
+	failed += soak_check(stalls == (p->stall > 0), "main loop stalls");
+	failed += soak_check(!stalls || (stall_task == TASK_WAIT && result->reported == TASK_WAIT + 1
+	&& record_max == stall_max), "stall record or report");
+	failed += soak_check(sim->eeprom[record] == TASK_NONE, "stall record left in EEPROM");
+	failed += soak_check(result->page_steps >= soak_presses(p, SOAK_DOWN) && result->page_strays == 0, "page step");
+	failed += soak_check(result->page_over <= 0, "page timeout");
+	failed += soak_check(result->max_cleared == (soak_presses(p, SOAK_UP | SOAK_DOWN) > 0), "maximum clear with both buttons");
+	failed += soak_check(hours <= p->hours && (resets || p->full_band >= 0
+	|| hours >= p->hours - HISTOGRAM_BINS * HISTOGRAM_BATCH / 60), "histogram hours");
+	failed += soak_check(result->histogram_writes <= p->hours * 60 / HISTOGRAM_BATCH, "histogram batching");
+	failed += soak_check(p->full_band < 0 || full == SOAK_FULL, "histogram band saturation");
+	failed += soak_check(p->years == 0 || hot_rate * 24 * 365 * p->years <= SOAK_CYCLES, "EEPROM endurance");
+	failed += soak_check(result->overruns == 0, "sampling overrun");
+	failed += soak_check(abs(result->temp_max - s->value_max) <= 2, "maximum does not follow readings");
+	failed += soak_check(result->temp_max / 16.0 <= peak + SOAK_LEAD, "maximum above tank temperature");
+	printf("  %s\n\n", failed ? "FAILED" : "ok");
+	return failed;
+}
+
+static double soak_room(double)
+{
+	return 21.3;
+}
+
+//Reads sensors on two lanes with one scratchpad transfer, then with second lane absent
+static int soak_lanes()
+{
+	int failed = 0, status;
+
+	printf("Lanes: %u-lane bus on port B\n", SoakLanes::Lanes);
+	for (uint8_t absent = 0; absent < 2; absent++){
+		memset(sim->sensor, 0, sizeof(sim->sensor));
+		memset(result, 0, sizeof(soak_result));
+		sim->now = 0;
+		sim->end = 10e6;
+		sim->tick_hook = NULL;
+		sim->exit_hook = NULL;
+		for (uint8_t n = 0; n < SoakLanes::Lanes; n++){
+			sim_sensor *s = &sim->sensor[n];
+			s->used = 1;
+			s->port = SIM_PORTB;
+			s->rx = 1 << (2 * n);
+			s->tx = 1 << (2 * n + 1);
+			s->present = !(absent && n == 1);
+			s->fluid = soak_room;
+			s->offset = 2.0 * n;
+			s->tau = SOAK_TAU;
+			s->ee[2] = 0x7F;
+			sensor_poweron(s);
+		}
+
+		fflush(stdout);
+		pid_t pid = fork();
+		if (pid == 0){
+			sim_boot();
+			ds18b20convertall<SoakLanes>();
+			sim_delay_us(800000);
+			result->lanes_failed = ds18b20readall<SoakLanes>(result->lanes, result->lanes_ec);
+			_exit(SIM_EXIT_END);
+		}
+		waitpid(pid, &status, 0);
+
+		for (uint8_t n = 0; n < SoakLanes::Lanes; n++){
+			sim_sensor *s = &sim->sensor[n];
+			printf("  lane %u %-8s %6.2f C, error %u\n", n, s->present ? "present" : "absent",
+			result->lanes[n] / 16.0, result->lanes_ec[n]);
+			if (s->present)
+			failed += soak_check(result->lanes_ec[n] == DS18B20_ERROR_OK && result->lanes[n] == s->conv_value, "lane reading");
+			else
+			failed += soak_check(result->lanes_ec[n] == DS18B20_ERROR_COMM && (result->lanes_failed & (1 << n)), "absent lane");
+		}
+	}
+	printf("  %s\n\n", failed ? "FAILED" : "ok");
+	return failed;
+}
+
+//Records bus of display unit from power-on through first readings
+static int soak_trace(const char *path)
+{
+	sim_sensor *s = &sim->sensor[0];
+	int status;
+
+	memset(sim->sensor, 0, sizeof(sim->sensor));
+	memset(result, 0, sizeof(soak_result));
+	sim->end = SOAK_TRACE * 1e6;
+	sim->reset_flags = (1 << PORF);
+	sim->tick_hook = NULL;
+	sim->exit_hook = NULL;
+	sim_eeprom_image();
+	s->used = 1;
+	s->port = SIM_PORTD;
+	s->rx = (1 << PD0);
+	s->tx = (1 << PD1);
+	s->present = 1;
+	s->fluid = soak_room;
+	s->tau = SOAK_TAU;
+	s->ee[2] = 0x7F;
+	memcpy(s->rom, soak_rom, 8);
+	sensor_poweron(s);
+
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0){
+		sim_boot();
+		sim_trace(path, 0);
+		firmware_main();
+		sim_finish(SIM_EXIT_END);
+	}
+	waitpid(pid, &status, 0);
+	printf("Trace: %.1f s of 1-Wire bus written to %s\n", SOAK_TRACE, path);
+	return !WIFEXITED(status) || WEXITSTATUS(status) != SIM_EXIT_END;
+}
+
+int main(int argc, char **argv)
+{
+	int failed = 0, runs = 0;
+
+	sim_setup();
+	result = (soak_result *)mmap(NULL, sizeof(soak_result), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (argc == 3 && strcmp(argv[1], "--trace") == 0) return soak_trace(argv[2]);
+	printf("EEPROM image %u of %u bytes (host layout)\n\n", sim_eeprom_image(), SIM_EEPROM_SIZE);
+
+	for (const soak_profile &p : soak_profiles){
+		int selected = argc < 2;
+		for (int i = 1; i < argc; i++)
+		if (strcmp(argv[i], p.name) == 0) selected = 1;
+		if (!selected) continue;
+		failed += soak_run(&p) != 0;
+		runs++;
+	}
+	if (argc < 2){
+		failed += soak_lanes() != 0;
+		runs++;
+	}
+	printf("Soak: %d runs, %d failed\n", runs, failed);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,16 @@
+/*
+* util/delay.h
+* Busy wait delays advance simulation time in host soak test
+* Author: Ketturi Electronics
+*/
+
+
+#ifndef sim_delay_H_
+#define sim_delay_H_
+
+#include "../sim.h"
+
+#define _delay_us(us) sim_delay_us(us)
+#define _delay_ms(ms) sim_delay_us((ms)*1000.0)
+
+#endif /* sim_delay_H_ */